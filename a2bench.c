@@ -0,0 +1,400 @@
+/**************************************************************
+ *                     a2bench.c
+ *
+ *     benchmark of blocked rotations. For every block shape it rotates
+ *     a raster of pixel-sized cells by each angle through the blocked
+ *     suite's block-major map, the way ppmtrans -block-major does, and
+ *     prints the best of a few runs as ns per pixel. With -pow2 it
+ *     instead sweeps square sizes around powers of two, with and without
+ *     padding, to show the cliffs where rows and blocks alias in the
+ *     cache. With -hilbert it compares the cache misses of 90 and 270
+ *     degree rotations in Hilbert order against block-major order.
+ *
+ **************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "assert.h"
+#include "a2methods.h"
+#include "a2blocked.h"
+#include "a2plain.h"
+#include "padding.h"
+#include "perfcount.h"
+#include "pnm.h"
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+/* Runs of each configuration; the fastest is reported */
+#define RUNS 3
+
+/* Shapes swept when none are given: squares (73 is the 64KB default),
+ * then rectangles whose rows or columns are whole 64-byte lines of
+ * 12-byte pixels, or nearly
+ */
+static const char *default_shapes[] = {
+        "8x8", "16x16", "32x32", "64x64", "73x73",
+        "32x8", "64x8", "64x4", "8x64", "4x64", "21x16", "16x21", "48x16",
+        "16x48", NULL
+};
+
+static const int angles[] = { 90, 180, 270 };
+
+/* Powers of two swept by -pow2; each is tried one below and one above */
+static const int pow2_sizes[] = { 256, 512, 1024, 2048, 4096 };
+
+struct rotation {
+        A2Methods_T methods;
+        A2 dest;
+        int width, height;      /* of the source */
+        int angle;
+};
+
+static void usage(const char *progname);
+static void shape_sweep(int width, int height, char **shapes, int nshapes);
+static void pow2_sweep(const char *shape);
+static void hilbert_compare(int width, int height, const char *shape);
+static void parse_shape(const char *shape, int *blk_width, int *blk_height);
+static void fill_random(A2Methods_T methods, A2 source);
+static double rotate_ns(A2Methods_T methods, A2Methods_mapfun *map,
+                        A2 source, int blk_width, int blk_height, int angle,
+                        struct Perf_counts *counts);
+static void rotate_cell(int col, int row, A2 array2, void *elem, void *cl);
+static double now_ns(void);
+
+int main(int argc, char *argv[])
+{
+        int width = 3000, height = 2000;
+        char **shapes = (char **) default_shapes;
+        int nshapes = 0;
+        bool pow2 = false;
+        bool hilbert = false;
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
+                        int end = 0;
+                        if (sscanf(argv[++i], "%dx%d%n", &width, &height,
+                                   &end) != 2 || argv[i][end] != '\0' ||
+                            width < 1 || height < 1) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-pow2") == 0) {
+                        pow2 = true;
+                } else if (strcmp(argv[i], "-hilbert") == 0) {
+                        hilbert = true;
+                } else if (strcmp(argv[i], "-shapes") == 0 && i + 1 < argc) {
+                        shapes = &argv[++i];
+                        for (nshapes = 0; i + nshapes < argc &&
+                             argv[i + nshapes][0] != '-'; nshapes++) {
+                        }
+                        i += nshapes - 1;
+                } else {
+                        usage(argv[0]);
+                }
+        }
+        if (shapes == (char **) default_shapes) {
+                while (default_shapes[nshapes] != NULL) {
+                        nshapes++;
+                }
+        }
+
+        if (pow2) {
+                /* One block shape is enough to show the cliffs */
+                pow2_sweep(nshapes > 0 ? shapes[0] : "64x64");
+        } else if (hilbert) {
+                hilbert_compare(width, height,
+                                nshapes > 0 ? shapes[0] : "64x64");
+        } else {
+                shape_sweep(width, height, shapes, nshapes);
+        }
+        return EXIT_SUCCESS;
+}
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-size <w>x<h>] "
+                        "[-shapes <w>x<h> ...]\n"
+                        "       %s -pow2 [-shapes <w>x<h>]\n"
+                        "       %s -hilbert [-size <w>x<h>] "
+                        "[-shapes <w>x<h>]\n", progname, progname,
+                        progname);
+        exit(1);
+}
+
+/**********shape_sweep********
+ * Prints ns per pixel of a width x height rotation for each shape and
+ * angle, one shape per line
+ * Inputs:
+ *              int width, height: dimensions of the source
+ *              char **shapes: "<w>x<h>" strings
+ *              int nshapes: their number
+ ************************/
+static void shape_sweep(int width, int height, char **shapes, int nshapes)
+{
+        A2Methods_T methods = uarray2_methods_blocked;
+        assert(methods->new_with_blockshape != NULL);
+
+        printf("%dx%d pixels, ns/pixel (best of %d)\n", width, height, RUNS);
+        printf("%-8s", "shape");
+        for (size_t a = 0; a < sizeof(angles) / sizeof(int); a++) {
+                printf("%9d", angles[a]);
+        }
+        printf("\n");
+
+        for (int s = 0; s < nshapes; s++) {
+                int blk_width, blk_height;
+                parse_shape(shapes[s], &blk_width, &blk_height);
+                A2 source = methods->new_with_blockshape(width, height,
+                        sizeof(struct Pnm_rgb), blk_width, blk_height);
+                fill_random(methods, source);
+
+                printf("%-8s", shapes[s]);
+                for (size_t a = 0; a < sizeof(angles) / sizeof(int); a++) {
+                        double ns = rotate_ns(methods,
+                                              methods->map_block_major,
+                                              source, blk_width,
+                                              blk_height, angles[a], NULL);
+                        printf("%9.2f", ns / ((double) width * height));
+                }
+                printf("\n");
+                methods->free(&source);
+        }
+}
+
+/**********pow2_sweep********
+ * Prints ns per pixel of 90 degree rotations of n x n images, for n one
+ * below, at and one above each power of two: row-major on the plain
+ * layout and block-major on the blocked one, each unpadded and padded
+ * Inputs: const char *shape: "<w>x<h>" block shape for the blocked runs
+ ************************/
+static void pow2_sweep(const char *shape)
+{
+        const struct {
+                const char *name;
+                A2Methods_T methods;
+                int policy;
+        } columns[] = {
+                { "plain", uarray2_methods_plain, PADDING_NONE },
+                { "+pad", uarray2_methods_plain, PADDING_AUTO },
+                { "blocked", uarray2_methods_blocked, PADDING_NONE },
+                { "+pad", uarray2_methods_blocked, PADDING_AUTO },
+        };
+        int ncolumns = sizeof(columns) / sizeof(columns[0]);
+        int blk_width, blk_height;
+        parse_shape(shape, &blk_width, &blk_height);
+
+        printf("n x n pixels rotated 90, ns/pixel (best of %d), "
+               "blocks %s\n", RUNS, shape);
+        printf("%-8s", "n");
+        for (int k = 0; k < ncolumns; k++) {
+                printf("%9s", columns[k].name);
+        }
+        printf("\n");
+
+        for (size_t p = 0; p < sizeof(pow2_sizes) / sizeof(int); p++) {
+                for (int n = pow2_sizes[p] - 1; n <= pow2_sizes[p] + 1;
+                     n++) {
+                        printf("%-8d", n);
+                        for (int k = 0; k < ncolumns; k++) {
+                                A2Methods_T methods = columns[k].methods;
+                                A2Methods_mapfun *map =
+                                        methods->map_block_major != NULL ?
+                                        methods->map_block_major :
+                                        methods->map_row_major;
+                                /* Arrays keep the policy they are made
+                                 * under
+                                 */
+                                Padding_set(columns[k].policy);
+                                A2 source = methods->new_with_blockshape(
+                                        n, n, sizeof(struct Pnm_rgb),
+                                        blk_width, blk_height);
+                                fill_random(methods, source);
+                                double ns = rotate_ns(methods, map, source,
+                                                      blk_width, blk_height,
+                                                      90, NULL);
+                                printf("%9.2f", ns / ((double) n * n));
+                                fflush(stdout);
+                                methods->free(&source);
+                        }
+                        printf("\n");
+                }
+        }
+        Padding_set(PADDING_AUTO);
+}
+
+/**********hilbert_compare********
+ * Prints ns, L1 data read misses and last level misses per pixel of
+ * width x height rotations by 90 and 270 degrees, for block-major order
+ * and both Hilbert orders of the blocked layout, and for row-major and
+ * Hilbert order of the plain layout
+ * Inputs:
+ *              int width, height: dimensions of the source
+ *              const char *shape: "<w>x<h>" block shape for the blocked runs
+ * Notes: misses are those of the fastest run, and print as -1 where the
+ *        kernel will not count them
+ ************************/
+static void hilbert_compare(int width, int height, const char *shape)
+{
+        const struct {
+                const char *name;
+                A2Methods_T methods;
+                bool hilbert;
+                bool cells;
+        } orders[] = {
+                { "block-major", uarray2_methods_blocked, false, false },
+                { "hilbert", uarray2_methods_blocked, true, false },
+                { "hilbert-cells", uarray2_methods_blocked, true, true },
+                { "row-major", uarray2_methods_plain, false, false },
+                { "plain-hilbert", uarray2_methods_plain, true, false },
+        };
+        const int turns[] = { 90, 270 };
+        int blk_width, blk_height;
+        parse_shape(shape, &blk_width, &blk_height);
+        double pixels = (double) width * height;
+
+        printf("%dx%d pixels, blocks %s, per pixel (best of %d)\n", width,
+               height, shape, RUNS);
+        printf("%-14s", "order");
+        for (size_t a = 0; a < sizeof(turns) / sizeof(int); a++) {
+                printf("%8d ns %6s %6s", turns[a], "L1d", "LLC");
+        }
+        printf("\n");
+
+        for (size_t k = 0; k < sizeof(orders) / sizeof(orders[0]); k++) {
+                A2Methods_T methods = orders[k].methods;
+                A2Methods_mapfun *map = orders[k].hilbert ?
+                        methods->map_hilbert :
+                        methods->map_block_major != NULL ?
+                        methods->map_block_major : methods->map_row_major;
+                A2Blocked_set_hilbert_cells(orders[k].cells);
+                A2 source = methods->new_with_blockshape(width, height,
+                        sizeof(struct Pnm_rgb), blk_width, blk_height);
+                fill_random(methods, source);
+
+                printf("%-14s", orders[k].name);
+                for (size_t a = 0; a < sizeof(turns) / sizeof(int); a++) {
+                        struct Perf_counts counts;
+                        double ns = rotate_ns(methods, map, source,
+                                              blk_width, blk_height,
+                                              turns[a], &counts);
+                        printf("%11.2f %6.2f %6.2f", ns / pixels,
+                               counts.l1d_misses < 0 ? -1 :
+                               counts.l1d_misses / pixels,
+                               counts.llc_misses < 0 ? -1 :
+                               counts.llc_misses / pixels);
+                }
+                printf("\n");
+                methods->free(&source);
+        }
+        A2Blocked_set_hilbert_cells(false);
+}
+
+/**********parse_shape********
+ * Reads a "<w>x<h>" block shape, exiting on anything else
+ ************************/
+static void parse_shape(const char *shape, int *blk_width, int *blk_height)
+{
+        int end = 0;
+        if (sscanf(shape, "%dx%d%n", blk_width, blk_height, &end) != 2 ||
+            shape[end] != '\0' || *blk_width < 1 || *blk_height < 1) {
+                fprintf(stderr, "bad shape '%s'\n", shape);
+                exit(1);
+        }
+}
+
+/**********fill_random********
+ * Fills every pixel of source with the same pseudo-random colors
+ ************************/
+static void fill_random(A2Methods_T methods, A2 source)
+{
+        unsigned seed = 1;
+        for (int row = 0; row < methods->height(source); row++) {
+                for (int col = 0; col < methods->width(source); col++) {
+                        struct Pnm_rgb *pixel = methods->at(source, col, row);
+                        pixel->red = rand_r(&seed) & 255;
+                        pixel->green = rand_r(&seed) & 255;
+                        pixel->blue = rand_r(&seed) & 255;
+                }
+        }
+}
+
+/**********rotate_ns********
+ * Best time of RUNS rotations of source by angle with map, each into a
+ * fresh destination whose blocks are turned with the image; counts, if
+ * not NULL, gets the hardware counts of the fastest run
+ ************************/
+static double rotate_ns(A2Methods_T methods, A2Methods_mapfun *map,
+                        A2 source, int blk_width, int blk_height, int angle,
+                        struct Perf_counts *counts)
+{
+        struct rotation rot = {
+                methods, NULL, methods->width(source),
+                methods->height(source), angle
+        };
+        bool turns = angle == 90 || angle == 270;
+        double best = 0;
+
+        for (int run = 0; run < RUNS; run++) {
+                rot.dest = methods->new_with_blockshape(
+                        turns ? rot.height : rot.width,
+                        turns ? rot.width : rot.height,
+                        sizeof(struct Pnm_rgb),
+                        turns ? blk_height : blk_width,
+                        turns ? blk_width : blk_height);
+                if (counts != NULL) {
+                        Perf_start();
+                }
+                double start = now_ns();
+                map(source, rotate_cell, &rot);
+                double ns = now_ns() - start;
+                if (counts != NULL) {
+                        Perf_stop();
+                }
+                if (run == 0 || ns < best) {
+                        best = ns;
+                        if (counts != NULL && !Perf_read(counts)) {
+                                counts->cycles = -1;
+                                counts->l1d_misses = -1;
+                                counts->llc_misses = -1;
+                        }
+                }
+                methods->free(&rot.dest);
+        }
+        return best;
+}
+
+/**********rotate_cell********
+ * apply function: copies one cell to its rotated place
+ ************************/
+static void rotate_cell(int col, int row, A2 array2, void *elem, void *cl)
+{
+        struct rotation *rot = cl;
+        int dcol = col, drow = row;
+        (void) array2;
+
+        switch (rot->angle) {
+        case 90:
+                dcol = rot->height - row - 1;
+                drow = col;
+                break;
+        case 180:
+                dcol = rot->width - col - 1;
+                drow = rot->height - row - 1;
+                break;
+        case 270:
+                dcol = row;
+                drow = rot->width - col - 1;
+                break;
+        }
+        *(struct Pnm_rgb *) rot->methods->at(rot->dest, dcol, drow) =
+                *(struct Pnm_rgb *) elem;
+}
+
+static double now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
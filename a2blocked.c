@@ -1,14 +1,28 @@
+#include <stdbool.h>
 #include <string.h>
 
-#include <a2blocked.h>
+#include "assert.h"
+#include "a2blocked.h"
 #include "uarray2b.h"
+#include "parallel.h"
+#include <stdlib.h>
 
 // define a private version of each function in A2Methods_T that we implement
 
 typedef A2Methods_UArray2 A2;   // private abbreviation
 
+/* Block shape new uses, 0 x 0 for the 64KB square default */
+static int shape_width, shape_height;
+
+/* Whether map_hilbert walks the cells of each block along the curve */
+static bool hilbert_cells;
+
 static A2 new(int width, int height, int size)
 {
+        if (shape_width > 0) {
+                return UArray2b_new_rect(width, height, size, shape_width,
+                                         shape_height);
+        }
         return UArray2b_new_64K_block(width, height, size);
 }
 
@@ -17,6 +31,23 @@ static A2 new_with_blocksize(int width, int height, int size, int blocksize)
         return UArray2b_new(width, height, size, blocksize);
 }
 
+static A2 new_with_blockshape(int width, int height, int size,
+                              int blk_width, int blk_height)
+{
+        return UArray2b_new_rect(width, height, size, blk_width, blk_height);
+}
+
+static A2 new_compressed(int width, int height, int size)
+{
+        return UArray2b_new_compressed(width, height, size, 0, 0);
+}
+
+static A2 new_compressed_with_blocksize(int width, int height, int size,
+                                        int blocksize)
+{
+        return UArray2b_new_compressed(width, height, size, blocksize, 0);
+}
+
 static void a2free(A2 * array2p)
 {
         UArray2b_free((UArray2b_T *) array2p);
@@ -44,6 +75,11 @@ static A2Methods_Object *at(A2 array2, int i, int j)
         return UArray2b_at(array2, i, j);
 }
 
+static const A2Methods_Object *get(A2 array2, int i, int j)
+{
+        return UArray2b_get(array2, i, j);
+}
+
 typedef void applyfun(int i, int j, UArray2b_T array2b, void *elem, void *cl);
 
 static void map_block_major(A2 array2, A2Methods_applyfun apply, void *cl)
@@ -72,6 +108,85 @@ static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
         UArray2b_map(a2, apply_small, &mycl);
 }
 
+static void map_hilbert(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        UArray2b_map_hilbert(array2, hilbert_cells, (applyfun *) apply, cl);
+}
+
+static void small_map_hilbert(A2 a2, A2Methods_smallapplyfun apply,
+                              void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        UArray2b_map_hilbert(a2, hilbert_cells, apply_small, &mycl);
+}
+
+/* Shared by the threads of a reduction: thread t folds into partials[t] */
+struct reduction {
+        A2Methods_UArray2 array2;
+        A2Methods_accumulatefun *accumulate;
+        void *cl;
+        char *partials;
+        size_t partial_size;
+};
+
+struct cell_closure {
+        struct reduction *red;
+        void *partial;
+};
+
+static void reduce_cell(int i, int j, UArray2b_T array2b, void *elem,
+                        void *vcl)
+{
+        struct cell_closure *cl = vcl;
+        (void)array2b;
+        cl->red->accumulate(i, j, elem, cl->partial, cl->red->cl);
+}
+
+static void reduce_blocks(int thread, int first, int last, void *vred)
+{
+        struct reduction *red = vred;
+        struct cell_closure cl = {
+                red, red->partials + thread * red->partial_size
+        };
+        UArray2b_read_range(red->array2, first, last, reduce_cell, &cl);
+}
+
+/* each thread folds a run of blocks; partials are merged in block
+ * order. Compressed arrays expand blocks into a cache that is not
+ * thread safe, and small arrays are not worth starting threads for, so
+ * both are folded on this thread.
+ */
+static void reduce(A2Methods_UArray2 array2,
+                   A2Methods_accumulatefun accumulate,
+                   A2Methods_mergefun merge, const void *identity,
+                   size_t partial_size, void *result, void *cl)
+{
+        int nthreads = UArray2b_compressed(array2) ? 1 :
+                       Parallel_nthreads_for((long) width(array2) *
+                                             height(array2));
+        struct reduction red = { array2, accumulate, cl,
+                                 malloc(nthreads * partial_size),
+                                 partial_size };
+        assert(red.partials != NULL);
+        for (int t = 0; t < nthreads; t++) {
+                memcpy(red.partials + t * partial_size, identity,
+                       partial_size);
+        }
+
+        if (nthreads == 1) {
+                reduce_blocks(0, 0, UArray2b_nblocks(array2), &red);
+        } else {
+                Parallel_run(nthreads, UArray2b_nblocks(array2),
+                             reduce_blocks, &red);
+        }
+
+        memcpy(result, identity, partial_size);
+        for (int t = 0; t < nthreads; t++) {
+                merge(result, red.partials + t * partial_size, cl);
+        }
+        free(red.partials);
+}
+
 static struct A2Methods_T uarray2_methods_blocked_struct = {
         new,
         new_with_blocksize,
@@ -89,8 +204,65 @@ static struct A2Methods_T uarray2_methods_blocked_struct = {
         NULL,                   // small_map_col_major
         small_map_block_major,
         small_map_block_major,  // small_map_default
+        reduce,
+        new_with_blockshape,
+        map_hilbert,
+        small_map_hilbert,
+        get,
 };
 
 // finally the payoff: here is the exported pointer to the struct
 
 A2Methods_T uarray2_methods_blocked = &uarray2_methods_blocked_struct;
+
+
+static struct A2Methods_T uarray2_methods_compressed_struct = {
+        new_compressed,
+        new_compressed_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                   // map_row_major
+        NULL,                   // map_col_major
+        map_block_major,
+        map_block_major,        // map_default
+        NULL,                   // small_map_row_major
+        NULL,                   // small_map_col_major
+        small_map_block_major,
+        small_map_block_major,  // small_map_default
+        reduce,
+        NULL,                   // new_with_blockshape: blocks are square
+        map_hilbert,
+        small_map_hilbert,
+        get,
+};
+
+A2Methods_T uarray2_methods_compressed = &uarray2_methods_compressed_struct;
+
+/**********A2Blocked_set_shape********
+ * Sets the block shape the blocked suite's new uses from now on
+ * Inputs: int blk_width, blk_height: the shape, or 0 x 0 for the 64KB
+ *         square default
+ * Expects: both positive or both zero; called before any thread uses
+ *          the suite
+ ************************/
+void A2Blocked_set_shape(int blk_width, int blk_height)
+{
+        assert((blk_width > 0 && blk_height > 0) ||
+               (blk_width == 0 && blk_height == 0));
+        shape_width = blk_width;
+        shape_height = blk_height;
+}
+
+/**********A2Blocked_set_hilbert_cells********
+ * Sets whether the blocked and compressed suites' map_hilbert walk the
+ * cells inside each block along a Hilbert curve, rather than row by row
+ * Expects: called before any thread uses the suites
+ ************************/
+void A2Blocked_set_hilbert_cells(bool cells)
+{
+        hilbert_cells = cells;
+}
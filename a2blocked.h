@@ -0,0 +1,21 @@
+#ifndef A2BLOCKED_INCLUDED
+#define A2BLOCKED_INCLUDED
+#include <stdbool.h>
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_blocked;
+
+/* same as the blocked suite, but blocks are kept packed when unused */
+extern A2Methods_T uarray2_methods_compressed;
+
+/* makes the blocked suite's new use blk_width x blk_height blocks (0 x 0
+ * for the 64KB default); set it before any array is made
+ */
+extern void A2Blocked_set_shape(int blk_width, int blk_height);
+
+/* makes map_hilbert walk the cells of each block along a Hilbert curve
+ * too, instead of row by row; off to begin with
+ */
+extern void A2Blocked_set_hilbert_cells(bool cells);
+
+#endif
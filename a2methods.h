@@ -0,0 +1,95 @@
+#ifndef A2METHODS_INCLUDED
+#define A2METHODS_INCLUDED
+
+#include <stddef.h>
+
+/*
+ * The course's A2Methods interface, extended: fields after
+ * small_map_default are ours. Suites that predate a field leave it
+ * NULL, so callers must check before using it.
+ */
+
+#define T A2Methods_UArray2    // for use in this interface only
+
+typedef void *T;                // a generic two-dimensional array
+typedef void A2Methods_Object;  // an unknown sequence of bytes in memory
+
+/* apply functions are called on an element's column, row, array and
+ * address; small apply functions only get the address
+ */
+typedef void A2Methods_applyfun(int i, int j, T array2, A2Methods_Object *ptr,
+                                void *cl);
+typedef void A2Methods_mapfun(T array2, A2Methods_applyfun apply, void *cl);
+
+typedef void A2Methods_smallapplyfun(A2Methods_Object *ptr, void *cl);
+typedef void A2Methods_smallmapfun(T a2, A2Methods_smallapplyfun f, void *cl);
+
+/* a reduction folds every element into a partial result of
+ * partial_size bytes; each thread's partial starts as a copy of the
+ * identity, and merge folds one finished partial into another. The
+ * element must not be written.
+ */
+typedef void A2Methods_accumulatefun(int i, int j, A2Methods_Object *ptr,
+                                     void *partial, void *cl);
+typedef void A2Methods_mergefun(void *partial, const void *other, void *cl);
+typedef void A2Methods_reducefun(T array2, A2Methods_accumulatefun accumulate,
+                                 A2Methods_mergefun merge,
+                                 const void *identity, size_t partial_size,
+                                 void *result, void *cl);
+
+typedef struct A2Methods_T {
+        // creates a distinct 2D array of memory cells, each of the
+        // given 'size'; every cell is initialized to zero
+        T (*new)(int width, int height, int size);
+
+        // creates a distinct 2D array of memory cells, each of the given
+        // 'size', where 'blocksize' is a hint to the representation
+        T (*new_with_blocksize)(int width, int height, int size,
+                                int blocksize);
+
+        // frees *array2p and overwrites the pointer with NULL
+        void (*free)(T *array2p);
+
+        // observe properties of the array
+        int (*width)(T array2);
+        int (*height)(T array2);
+        int (*size)(T array2);
+        int (*blocksize)(T array2); // for an unblocked array, returns 1
+
+        // returns a pointer to the object in column i, row j
+        A2Methods_Object *(*at)(T array2, int i, int j);
+
+        // mapping functions, NULL where a suite has no such order
+        A2Methods_mapfun *map_row_major;
+        A2Methods_mapfun *map_col_major;
+        A2Methods_mapfun *map_block_major;
+        A2Methods_mapfun *map_default;  // always the fastest order
+
+        A2Methods_smallmapfun *small_map_row_major;
+        A2Methods_smallmapfun *small_map_col_major;
+        A2Methods_smallmapfun *small_map_block_major;
+        A2Methods_smallmapfun *small_map_default;
+
+        // folds every element into *result (partial_size bytes), on
+        // several threads in whatever order is fastest
+        A2Methods_reducefun *reduce;
+
+        // like new_with_blocksize, but with blocks of blk_width x
+        // blk_height cells; NULL if the representation cannot do it
+        T (*new_with_blockshape)(int width, int height, int size,
+                                 int blk_width, int blk_height);
+
+        // visit every element along a Hilbert curve, so consecutive
+        // elements are neighbours in both directions; blocked suites
+        // walk the blocks along the curve. NULL if not supported.
+        A2Methods_mapfun *map_hilbert;
+        A2Methods_smallmapfun *small_map_hilbert;
+
+        // like at, but for reading only: never allocates or unshares
+        // storage, and the object must not be written through the
+        // pointer, which may only last until the next access
+        const A2Methods_Object *(*get)(T array2, int i, int j);
+} *A2Methods_T;
+
+#undef T
+#endif
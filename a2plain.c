@@ -1,7 +1,22 @@
 #include <string.h>
 
-#include <a2plain.h>
-#include "uarray2.h"
+#include "assert.h"
+#include "a2plain.h"
+#include "padding.h"
+#include "hilbert.h"
+#include "parallel.h"
+#include <stdlib.h>
+
+/* A row-major array whose rows start pitch cells apart. The pitch is
+ * padded past the width when the row stride would alias in the cache
+ * (see padding.h); the cells in between are never mapped.
+ */
+struct plain {
+        int width, height;
+        int size;
+        int pitch;              /* cells from one row start to the next */
+        char *cells;
+};
 
 /************************************************/
 /* Define a private version of each function in */
@@ -10,33 +25,135 @@
 
 static A2Methods_UArray2 new(int width, int height, int size)
 {
-        //TODO: Implement this function and remove the dummy return statement.
-        return NULL;
+        assert(width >= 0 && height >= 0 && size > 0);
+        struct plain *plain = malloc(sizeof(*plain));
+        assert(plain != NULL);
+        plain->width = width;
+        plain->height = height;
+        plain->size = size;
+        plain->pitch = Padding_pitch(width, size);
+        /* one spare cell so an empty array still gets storage */
+        plain->cells = calloc((size_t) plain->pitch * height + 1, size);
+        assert(plain->cells != NULL);
+        return plain;
 }
 
 static A2Methods_UArray2 new_with_blocksize(int width, int height, int size,
                                             int blocksize)
 {
-        //TODO: Implement this function and remove the dummy return statement.
         (void) blocksize;
-        return NULL;
+        return new(width, height, size);
 }
 
+static A2Methods_UArray2 new_with_blockshape(int width, int height,
+                                             int size, int blk_width,
+                                             int blk_height)
+{
+        (void) blk_width;
+        (void) blk_height;
+        return new(width, height, size);
+}
+
+static void a2free(A2Methods_UArray2 *array2p)
+{
+        assert(array2p != NULL && *array2p != NULL);
+        struct plain *plain = *array2p;
+        free(plain->cells);
+        free(plain);
+        *array2p = NULL;
+}
+
+static int width(A2Methods_UArray2 array2)
+{
+        struct plain *plain = array2;
+        return plain->width;
+}
+
+static int height(A2Methods_UArray2 array2)
+{
+        struct plain *plain = array2;
+        return plain->height;
+}
+
+static int size(A2Methods_UArray2 array2)
+{
+        struct plain *plain = array2;
+        return plain->size;
+}
+
+static int blocksize(A2Methods_UArray2 array2)
+{
+        (void) array2;
+        return 1;
+}
+
+static inline char *cell(struct plain *plain, int i, int j)
+{
+        return plain->cells + ((size_t) plain->pitch * j + i) * plain->size;
+}
+
+static A2Methods_Object *at(A2Methods_UArray2 array2, int i, int j)
+{
+        struct plain *plain = array2;
+        assert(i >= 0 && i < plain->width);
+        assert(j >= 0 && j < plain->height);
+        return cell(plain, i, j);
+}
 
-/* TODO: ...many more private (static) definitions follow */
+static const A2Methods_Object *get(A2Methods_UArray2 array2, int i, int j)
+{
+        return at(array2, i, j);
+}
 
 static void map_row_major(A2Methods_UArray2 uarray2,
                           A2Methods_applyfun apply,
                           void *cl)
 {
-        UArray2_map_row_major(uarray2, (UArray2_applyfun*)apply, cl);
+        struct plain *plain = uarray2;
+        for (int j = 0; j < plain->height; j++) {
+                char *elem = cell(plain, 0, j);
+                for (int i = 0; i < plain->width; i++) {
+                        apply(i, j, uarray2, elem, cl);
+                        elem += plain->size;
+                }
+        }
 }
 
 static void map_col_major(A2Methods_UArray2 uarray2,
                           A2Methods_applyfun apply,
                           void *cl)
 {
-        UArray2_map_col_major(uarray2, (UArray2_applyfun*)apply, cl);
+        struct plain *plain = uarray2;
+        size_t stride = (size_t) plain->pitch * plain->size;
+        for (int i = 0; i < plain->width; i++) {
+                char *elem = cell(plain, i, 0);
+                for (int j = 0; j < plain->height; j++) {
+                        apply(i, j, uarray2, elem, cl);
+                        elem += stride;
+                }
+        }
+}
+
+/* A Hilbert-order map in progress */
+struct hilbert_map {
+        struct plain *plain;
+        A2Methods_applyfun *apply;
+        void *cl;
+};
+
+static void visit_cell(int i, int j, void *vmap)
+{
+        struct hilbert_map *map = vmap;
+        map->apply(i, j, map->plain, cell(map->plain, i, j), map->cl);
+}
+
+static void map_hilbert(A2Methods_UArray2 uarray2,
+                        A2Methods_applyfun apply,
+                        void *cl)
+{
+        struct plain *plain = uarray2;
+        struct hilbert_map map = { plain, apply, cl };
+        Hilbert_walk(plain->width, plain->height, visit_cell, &map);
 }
 
 struct small_closure {
@@ -44,7 +161,7 @@ struct small_closure {
         void                    *cl;
 };
 
-static void apply_small(int i, int j, UArray2_T uarray2,
+static void apply_small(int i, int j, A2Methods_UArray2 uarray2,
                         void *elem, void *vcl)
 {
         struct small_closure *cl = vcl;
@@ -59,7 +176,7 @@ static void small_map_row_major(A2Methods_UArray2        a2,
                                 void *cl)
 {
         struct small_closure mycl = { apply, cl };
-        UArray2_map_row_major(a2, apply_small, &mycl);
+        map_row_major(a2, apply_small, &mycl);
 }
 
 static void small_map_col_major(A2Methods_UArray2        a2,
@@ -67,16 +184,96 @@ static void small_map_col_major(A2Methods_UArray2        a2,
                                 void *cl)
 {
         struct small_closure mycl = { apply, cl };
-        UArray2_map_col_major(a2, apply_small, &mycl);
+        map_col_major(a2, apply_small, &mycl);
 }
 
+static void small_map_hilbert(A2Methods_UArray2        a2,
+                              A2Methods_smallapplyfun  apply,
+                              void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_hilbert(a2, apply_small, &mycl);
+}
+
+
+/* Shared by the threads of a reduction: thread t folds into partials[t] */
+struct reduction {
+        A2Methods_UArray2 array2;
+        A2Methods_accumulatefun *accumulate;
+        void *cl;
+        char *partials;
+        size_t partial_size;
+};
+
+static void reduce_rows(int thread, int first, int last, void *vred)
+{
+        struct reduction *red = vred;
+        void *partial = red->partials + thread * red->partial_size;
+        struct plain *plain = red->array2;
+
+        for (int j = first; j < last; j++) {
+                char *elem = cell(plain, 0, j);
+                for (int i = 0; i < plain->width; i++) {
+                        red->accumulate(i, j, elem, partial, red->cl);
+                        elem += plain->size;
+                }
+        }
+}
+
+/* each thread folds a run of rows; partials are merged in row order.
+ * Small arrays are folded on this thread.
+ */
+static void reduce(A2Methods_UArray2 array2,
+                   A2Methods_accumulatefun accumulate,
+                   A2Methods_mergefun merge, const void *identity,
+                   size_t partial_size, void *result, void *cl)
+{
+        int nthreads = Parallel_nthreads_for((long) width(array2) *
+                                             height(array2));
+        struct reduction red = { array2, accumulate, cl,
+                                 malloc(nthreads * partial_size),
+                                 partial_size };
+        assert(red.partials != NULL);
+        for (int t = 0; t < nthreads; t++) {
+                memcpy(red.partials + t * partial_size, identity,
+                       partial_size);
+        }
+
+        if (nthreads == 1) {
+                reduce_rows(0, 0, height(array2), &red);
+        } else {
+                Parallel_run(nthreads, height(array2), reduce_rows, &red);
+        }
+
+        memcpy(result, identity, partial_size);
+        for (int t = 0; t < nthreads; t++) {
+                merge(result, red.partials + t * partial_size, cl);
+        }
+        free(red.partials);
+}
 
 static struct A2Methods_T uarray2_methods_plain_struct = {
         new,
         new_with_blocksize,
-        /* ... other functions follow in order,
-         *     with NULL for those not implemented ...
-         */
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        map_row_major,
+        map_col_major,
+        NULL,                   // map_block_major
+        map_row_major,          // map_default
+        small_map_row_major,
+        small_map_col_major,
+        NULL,                   // small_map_block_major
+        small_map_row_major,    // small_map_default
+        reduce,
+        new_with_blockshape,
+        map_hilbert,
+        small_map_hilbert,
+        get,
 };
 
 // finally the payoff: here is the exported pointer to the struct
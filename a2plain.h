@@ -0,0 +1,7 @@
+#ifndef A2PLAIN_INCLUDED
+#define A2PLAIN_INCLUDED
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_plain;
+
+#endif
@@ -1,9 +1,32 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "assert.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2view.h"
+#include "uarray2b.h"
+#include "blockcodec.h"
+#include "planar.h"
+#include "padding.h"
+#include "dihedral.h"
+#include "rotate.h"
+#include "rasterpool.h"
+#include "serve.h"
+#include "pipeline.h"
+#include "parallel.h"
+#include "planner.h"
+#include "perfcount.h"
+#include "trace.h"
+#include "memacct.h"
+#include "pnm.h"
 
 
 #define W 13
@@ -161,12 +184,1344 @@ static void test_methods(A2Methods_T methods_under_test)
         methods->free(&array);
 }
 
+/* Feature checks: each drives one representation through its own
+ * interface, where the rotation check below cannot reach
+ */
+
+static void count_cell(void *elem, void *cl)
+{
+        (void)elem;
+        *(long *) cl += 1;
+}
+
+/* Encodes and decodes uniform, run-length and verbatim blocks */
+static void check_codec(void)
+{
+        int uniform[64], runs[64], noise[64], back[64];
+        unsigned seed = 7;
+        for (int k = 0; k < 64; k++) {
+                uniform[k] = 42;
+                runs[k] = k / 16;
+                noise[k] = rand_r(&seed);
+        }
+        int *inputs[] = { uniform, runs, noise };
+        int kinds[] = { CODEC_UNIFORM, CODEC_RLE, CODEC_VERBATIM };
+
+        for (int t = 0; t < 3; t++) {
+                unsigned char *packed;
+                int nbytes;
+                int kind = Codec_encode(inputs[t], 64, sizeof(int), &packed,
+                                        &nbytes);
+                assert(kind == kinds[t]);
+                Codec_decode(kind, packed, nbytes, back, 64, sizeof(int));
+                assert(memcmp(back, inputs[t], sizeof(back)) == 0);
+                free(packed);
+        }
+}
+
+static void sum_cell(int i, int j, A2Methods_Object *elem, void *partial,
+                     void *cl)
+{
+        (void) i;
+        (void) j;
+        (void) cl;
+        *(unsigned long long *) partial += *(int *) elem;
+}
+
+static void merge_sums(void *partial, const void *other, void *cl)
+{
+        (void)cl;
+        *(unsigned long long *) partial += *(const unsigned long long *) other;
+}
+
+/* Writes every cell of a compressed array whose cache holds only two
+ * blocks, so nearly every access evicts, then reads them all back
+ */
+static void check_compressed(void)
+{
+        int width = 37, height = 21;
+        UArray2b_T array = UArray2b_new_compressed(width, height, sizeof(int),
+                                                   4, 2);
+        for (int j = 0; j < height; j++) {
+                assert(*(const int *) UArray2b_get(array, width - 1, j) == 0);
+        }
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        *(int *) UArray2b_at(array, i, j) = 1000 * i + j;
+                }
+        }
+        for (int i = width - 1; i >= 0; i--) {
+                for (int j = 0; j < height; j++) {
+                        assert(*(const int *) UArray2b_get(array, i, j) ==
+                               1000 * i + j);
+                }
+        }
+
+        /* Blocks a fill covers become uniform, and take far less room */
+        int seven = 7;
+        UArray2b_fill(array, 0, 0, width, height, &seven);
+        assert(UArray2b_footprint(array) <
+               (size_t) width * height * sizeof(int) / 4);
+        assert(*(int *) UArray2b_at(array, 20, 10) == 7);
+        UArray2b_free(&array);
+
+        /* A reduce over written blocks must not lose the writes when the
+         * blocks are evicted afterwards */
+        array = UArray2b_new_compressed(16, 4, sizeof(int), 4, 2);
+        A2Methods_T packed = uarray2_methods_compressed;
+        *(int *) UArray2b_at(array, 0, 0) = 7;
+        unsigned long long sum, zero = 0;
+        packed->reduce(array, sum_cell, merge_sums, &zero, sizeof(sum), &sum,
+                       NULL);
+        assert(sum == 7);
+        for (int i = 4; i < 16; i += 4) {
+                *(int *) UArray2b_at(array, i, 0) = i;
+        }
+        for (int i = 0; i < 16; i += 4) {
+                assert(*(const int *) UArray2b_get(array, i, 0) ==
+                       (i == 0 ? 7 : i));
+        }
+        UArray2b_free(&array);
+}
+
+static void read_cell(int col, int row, UArray2b_T array, void *elem,
+                      void *cl)
+{
+        (void) col;
+        (void) row;
+        (void) array;
+        *(long *) cl += *(int *) elem;
+}
+
+static void count_visit(int col, int row, UArray2b_T array, void *elem,
+                        void *cl)
+{
+        (void) col;
+        (void) row;
+        (void) array;
+        (void) elem;
+        *(long *) cl += 1;
+}
+
+/* A huge blocked array stores only the blocks written or allocated; reads
+ * of the rest see zeros without storing anything
+ */
+static void check_deferred(void)
+{
+        UArray2b_T array = UArray2b_new(100000, 100000, sizeof(int), 64);
+        int nblocks = UArray2b_nblocks(array);
+        assert(UArray2b_footprint(array) == 0);
+        assert(*(const int *) UArray2b_get(array, 99999, 99999) == 0);
+        assert(*(const int *) UArray2b_get(array, 500, 70000) == 0);
+        assert(UArray2b_footprint(array) == 0);
+
+        *(int *) UArray2b_at(array, 0, 0) = 3;
+        *(int *) UArray2b_at(array, 99999, 99999) = 4;
+        size_t written = UArray2b_footprint(array);
+        assert(written >= 2 * 64 * 64 * sizeof(int) &&
+               written < 4 * 64 * 64 * sizeof(int));
+
+        long cells = 0;
+        UArray2b_map_touched(array, count_visit, &cells);
+        assert(cells == 64 * 64 + 32 * 32);     /* a corner block is cut */
+
+        /* The first row of blocks, read without being allocated */
+        long sum = 0;
+        UArray2b_read_range(array, 0, (100000 + 63) / 64, read_cell, &sum);
+        assert(sum == 3);
+        assert(UArray2b_footprint(array) == written);
+
+        UArray2b_alloc_range(array, nblocks - 3, nblocks);
+        assert(UArray2b_footprint(array) >= written + 2 * 64 * 64 *
+                                                       sizeof(int));
+        assert(*(const int *) UArray2b_get(array, 99999, 99999) == 4);
+        assert(*(const int *) UArray2b_get(array, 0, 0) == 3);
+        UArray2b_free(&array);
+}
+
+/* A copy shares every block until one side writes to it, then only
+ * that block is copied; either side can be freed first
+ */
+static void check_copy(void)
+{
+        UArray2b_T original = UArray2b_new(40, 30, sizeof(int), 8);
+        for (int j = 0; j < 30; j++) {
+                for (int i = 0; i < 24; i++) {
+                        *(int *) UArray2b_at(original, i, j) = i + 100 * j;
+                }
+        }
+        size_t stored = UArray2b_footprint(original);
+        UArray2b_T copy = UArray2b_copy(original);
+        assert(UArray2b_footprint(copy) == stored);
+        assert(UArray2b_get(copy, 3, 4) == UArray2b_get(original, 3, 4));
+
+        /* Writing the copy leaves the original, and other blocks, alone */
+        *(int *) UArray2b_at(copy, 3, 4) = -1;
+        assert(*(const int *) UArray2b_get(original, 3, 4) == 403);
+        assert(*(const int *) UArray2b_get(copy, 3, 4) == -1);
+        assert(*(const int *) UArray2b_get(copy, 4, 3) == 304);
+        assert(UArray2b_get(copy, 20, 20) == UArray2b_get(original, 20, 20));
+
+        /* And the other way round, including a block neither had stored */
+        *(int *) UArray2b_at(original, 20, 20) = -2;
+        *(int *) UArray2b_at(original, 35, 25) = -3;
+        assert(*(const int *) UArray2b_get(copy, 20, 20) == 2020);
+        assert(*(const int *) UArray2b_get(copy, 35, 25) == 0);
+
+        UArray2b_free(&original);
+        for (int j = 0; j < 30; j++) {
+                for (int i = 0; i < 24; i++) {
+                        int want = (i == 3 && j == 4) ? -1 : i + 100 * j;
+                        assert(*(const int *) UArray2b_get(copy, i, j) ==
+                               want);
+                }
+        }
+        UArray2b_free(&copy);
+}
+
+/* Reads blocked rasters through views: a read must neither allocate
+ * untouched blocks nor unshare blocks shared with a copy
+ */
+static void check_views(void)
+{
+        A2Methods_T blocked = uarray2_methods_blocked;
+        UArray2b_T sparse = UArray2b_new(40, 30, sizeof(int), 8);
+        *(int *) UArray2b_at(sparse, 3, 4) = 5;
+        size_t touched = UArray2b_footprint(sparse);
+
+        A2View_T view = A2View_transform(blocked, sparse, DIHEDRAL_ROT90);
+        A2 copy = A2View_materialize(view, uarray2_methods_plain);
+        assert(*(int *) uarray2_methods_plain->at(copy, 30 - 4 - 1, 3) == 5);
+        assert(UArray2b_footprint(sparse) == touched);
+        uarray2_methods_plain->free(&copy);
+        A2View_free(&view);
+
+        UArray2b_T shared = UArray2b_copy(sparse);
+        view = A2View_transform(blocked, shared, DIHEDRAL_ROT180);
+        long cells = 0;
+        uarray2_methods_view->small_map_default(view, count_cell, &cells);
+        assert(cells == 40 * 30);
+        assert(*(const int *) uarray2_methods_view->get(view, 40 - 3 - 1,
+                                                         30 - 4 - 1) == 5);
+        assert(UArray2b_get(shared, 3, 4) == UArray2b_get(sparse, 3, 4));
+        A2View_free(&view);
+        UArray2b_free(&shared);
+        UArray2b_free(&sparse);
+}
+
+/* Sends a pipelined pair of requests over a socket pair and reads them
+ * back whole; a read past the closed end must fail rather than block
+ */
+static void check_serve(void)
+{
+        int fds[2];
+        assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        struct Serve_header header = { SERVE_MAGIC, SERVE_TRANSFORM, 90,
+                                       SERVE_BLOCK_MAJOR, 5 };
+        for (int k = 0; k < 2; k++) {
+                assert(Serve_write_all(fds[0], &header, sizeof(header)) == 0);
+                assert(Serve_write_all(fds[0], "P6 1\n", 5) == 0);
+        }
+        close(fds[0]);
+
+        for (int k = 0; k < 2; k++) {
+                struct Serve_header got;
+                char body[5];
+                assert(Serve_read_all(fds[1], &got, sizeof(got)) == 0);
+                assert(memcmp(&got, &header, sizeof(got)) == 0);
+                assert(Serve_read_all(fds[1], body, sizeof(body)) == 0);
+                assert(memcmp(body, "P6 1\n", 5) == 0);
+        }
+        char extra;
+        assert(Serve_read_all(fds[1], &extra, 1) == -1);
+        close(fds[1]);
+}
+
+/* Answers a transform with its angle and layout followed by the image
+ * reversed, so a reply shows the request reached the handler intact
+ */
+static int echo_handler(const char *image, size_t length, FILE *out,
+                        int angle, int layout)
+{
+        fprintf(out, "%d %d ", angle, layout);
+        for (size_t k = length; k > 0; k--) {
+                fputc(image[k - 1], out);
+        }
+        return 0;
+}
+
+static char serve_path[64];
+
+static void *serve_main(void *unused)
+{
+        (void) unused;
+        Serve_run(serve_path, 1, echo_handler);
+        return NULL;
+}
+
+/* Connects to the test daemon, waiting for it to start listening */
+static int serve_connect(void)
+{
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, serve_path);
+        for (int tries = 0; tries < 1000; tries++) {
+                int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                assert(fd >= 0);
+                if (connect(fd, (struct sockaddr *) &addr,
+                            sizeof(addr)) == 0) {
+                        return fd;
+                }
+                close(fd);
+                nanosleep(&(struct timespec) { 0, 1000000 }, NULL);
+        }
+        assert(0);
+        return -1;
+}
+
+/* Reads one reply; returns its malloc'd, NUL-terminated body */
+static char *serve_reply(int fd, uint32_t status)
+{
+        struct Serve_reply reply;
+        assert(Serve_read_all(fd, &reply, sizeof(reply)) == 0);
+        assert(reply.status == status);
+        char *body = malloc(reply.length + 1);
+        assert(body != NULL);
+        assert(Serve_read_all(fd, body, reply.length) == 0);
+        body[reply.length] = '\0';
+        return body;
+}
+
+/* Runs the daemon on a temporary socket: a transform and a stats
+ * request on one connection are answered in order, and a request with
+ * a bad magic number or an oversized image is refused and its
+ * connection closed
+ */
+static void check_serve_run(void)
+{
+        snprintf(serve_path, sizeof(serve_path), "/tmp/a2test-%d.sock",
+                 (int) getpid());
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, serve_main, NULL) == 0);
+        pthread_detach(thread);
+
+        int fd = serve_connect();
+        struct Serve_header header = { SERVE_MAGIC, SERVE_TRANSFORM, 90,
+                                       SERVE_BLOCK_MAJOR, 3 };
+        assert(Serve_write_all(fd, &header, sizeof(header)) == 0);
+        assert(Serve_write_all(fd, "abc", 3) == 0);
+        header = (struct Serve_header) { SERVE_MAGIC, SERVE_STATS, 0, 0, 0 };
+        assert(Serve_write_all(fd, &header, sizeof(header)) == 0);
+        char *body = serve_reply(fd, 0);
+        assert(strcmp(body, "90 2 cba") == 0);
+        free(body);
+        body = serve_reply(fd, 0);
+        assert(strstr(body, "requests 1\nerrors 0\n") == body);
+        free(body);
+        close(fd);
+
+        struct Serve_header bad[] = {
+                { SERVE_MAGIC + 1, SERVE_TRANSFORM, 0, 0, 3 },
+                { SERVE_MAGIC, SERVE_TRANSFORM, 0, 0, SERVE_MAX_LENGTH + 1 },
+        };
+        for (size_t k = 0; k < sizeof(bad) / sizeof(bad[0]); k++) {
+                fd = serve_connect();
+                assert(Serve_write_all(fd, &bad[k], sizeof(bad[k])) == 0);
+                free(serve_reply(fd, 1));
+                char extra;
+                assert(Serve_read_all(fd, &extra, 1) == -1);
+                close(fd);
+        }
+        unlink(serve_path);
+}
+
+/* A pooled blocked suite recycles its rasters, but a raster freed while
+ * a copy still shares its blocks is freed outright, and writing the
+ * next raster leaves the copy alone
+ */
+static void check_pool(void)
+{
+        A2Methods_T pooled = Pool_methods(uarray2_methods_blocked);
+        assert(pooled->map_block_major != NULL);
+        A2 raster = pooled->new(20, 10, sizeof(int));
+        for (int j = 0; j < 10; j++) {
+                for (int i = 0; i < 20; i++) {
+                        *(int *) pooled->at(raster, i, j) = i + 100 * j;
+                }
+        }
+        A2 kept = raster;
+        pooled->free(&raster);
+        assert(raster == NULL);
+        raster = pooled->new(20, 10, sizeof(int));
+        assert(raster == kept);
+
+        UArray2b_T copy = UArray2b_rotate(raster, 0);
+        assert(UArray2b_shared(raster) && UArray2b_shared(copy));
+        pooled->free(&raster);
+
+        /* A fresh blocked raster has no blocks until it is written */
+        A2 again = pooled->new(20, 10, sizeof(int));
+        assert(UArray2b_footprint(again) == 0);
+        for (int j = 0; j < 10; j++) {
+                for (int i = 0; i < 20; i++) {
+                        *(int *) pooled->at(again, i, j) = -1;
+                }
+        }
+        assert(!UArray2b_shared(copy));
+        for (int j = 0; j < 10; j++) {
+                for (int i = 0; i < 20; i++) {
+                        assert(*(const int *) UArray2b_get(copy, i, j) ==
+                               i + 100 * j);
+                }
+        }
+        UArray2b_free(&copy);
+        uarray2_methods_blocked->free(&again);
+}
+
+/* Streams a small P6 image through the pipeline with more workers than
+ * some strips need, and checks the rotated image read back from memory
+ */
+static void check_pipeline(void)
+{
+        int width = 13, height = 7;
+        char *input;
+        size_t length;
+        FILE *in = open_memstream(&input, &length);
+        fprintf(in, "P6\n%d %d\n255\n", width, height);
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        fputc(i, in);
+                        fputc(j, in);
+                        fputc(i + j, in);
+                }
+        }
+        fclose(in);
+
+        for (int angle = 0; angle < 360; angle += 90) {
+                in = fmemopen(input, length, "rb");
+                char *output;
+                size_t olength;
+                FILE *out = open_memstream(&output, &olength);
+                struct Pipeline_stats stats;
+                assert(Pipeline_run(in, out, uarray2_methods_blocked, angle,
+                                    3, &stats) == 0);
+                assert(stats.width == width && stats.height == height);
+                fclose(in);
+                fclose(out);
+
+                out = fmemopen(output, olength, "rb");
+                Pnm_ppm ppm = Pnm_ppmread(out, uarray2_methods_plain);
+                A2Methods_T plain = uarray2_methods_plain;
+                for (int j = 0; j < height; j++) {
+                        for (int i = 0; i < width; i++) {
+                                int col, row;
+                                Dihedral_point(Dihedral_from_angle(angle), width,
+                                               height, i, j, &col, &row);
+                                Pnm_rgb pixel = plain->at(ppm->pixels, col,
+                                                          row);
+                                assert(pixel->red == (unsigned) i &&
+                                       pixel->green == (unsigned) j &&
+                                       pixel->blue == (unsigned) (i + j));
+                        }
+                }
+                Pnm_ppmfree(&ppm);
+                fclose(out);
+                free(output);
+        }
+
+        /* A body cut short fails before anything, header included, is
+         * written
+         */
+        for (int angle = 0; angle < 360; angle += 90) {
+                in = fmemopen(input, length - 1, "rb");
+                char *output;
+                size_t olength;
+                FILE *out = open_memstream(&output, &olength);
+                assert(Pipeline_run(in, out, uarray2_methods_blocked, angle,
+                                    3, NULL) != 0);
+                fclose(in);
+                fclose(out);
+                assert(olength == 0);
+                free(output);
+        }
+        free(input);
+}
+
+static void record_owner(int thread, int first, int last, void *cl)
+{
+        int *owner = cl;
+        for (int k = first; k < last; k++) {
+                assert(owner[k] == -1);
+                owner[k] = thread;
+        }
+}
+
+static void record_part(void *mem, size_t bytes, int part, void *cl)
+{
+        int **next = cl;
+        (void) mem;
+        (void) bytes;
+        *(*next)++ = part;
+}
+
+/* Owner for a 70-wide array of 8x8 blocks: the block holding the cell */
+static int block_of_cell(int col, int row, void *cl)
+{
+        (void) cl;
+        return row / 8 * 9 + col / 8;
+}
+
+/* A parallel rotation places each destination block for the thread that
+ * will write it, so UArray2b_place must split blocks as Parallel_run
+ * splits items
+ */
+static void check_parallel(void)
+{
+        UArray2b_T array = UArray2b_new(70, 45, sizeof(int), 8);
+        int nblocks = UArray2b_nblocks(array);
+        int owner[nblocks], parts[nblocks];
+        for (int nthreads = 1; nthreads <= 5; nthreads++) {
+                for (int k = 0; k < nblocks; k++) {
+                        owner[k] = -1;
+                }
+                Parallel_run(nthreads, nblocks, record_owner, owner);
+                int *next = parts;
+                UArray2b_place(array, nthreads, record_part, &next);
+                assert(next == parts + nblocks);
+                for (int k = 0; k < nblocks; k++) {
+                        assert(owner[k] >= 0 && owner[k] == parts[k]);
+                }
+        }
+        UArray2b_free(&array);
+
+        /* Work below the grain stays on the calling thread */
+        int most = Parallel_nthreads();
+        assert(Parallel_nthreads_for(0) == 1);
+        assert(Parallel_nthreads_for(PARALLEL_GRAIN - 1) == 1);
+        assert(Parallel_nthreads_for(2 * PARALLEL_GRAIN) == (most < 2 ? most
+                                                                  : 2));
+        assert(Parallel_nthreads_for(1L << 40) == most);
+
+        /* The source is placed block by block, by whoever owns a cell of
+         * the block, and blocks never touched are skipped
+         */
+        array = UArray2b_new(70, 45, sizeof(int), 8);
+        *(int *) UArray2b_at(array, 69, 44) = 1;
+        *(int *) UArray2b_at(array, 3, 4) = 1;
+        *(int *) UArray2b_at(array, 20, 10) = 1;
+        int *next = parts;
+        UArray2b_place_owned(array, block_of_cell, record_part, &next);
+        assert(next == parts + 3);
+        assert(parts[0] == 0 && parts[1] == 9 + 2 && parts[2] == 5 * 9 + 8);
+        UArray2b_free(&array);
+}
+
+/* Reads dimensions past comments, and checks that every plan's suite
+ * makes rasters of the planned block shape
+ */
+static void check_planner(void)
+{
+        const char header[] = "P6\n# comment 9 9\n301 203\n255\n";
+        int width, height;
+        assert(Plan_dimensions(header, sizeof(header) - 1, &width, &height));
+        assert(width == 301 && height == 203);
+        assert(!Plan_dimensions("P5\n3 3\n", 7, &width, &height));
+        assert(!Plan_dimensions("P6\n3", 4, &width, &height));
+
+        /* Caches small enough that the larger turns plan block-major */
+        struct Plan_machine machine = { 4 << 10, 16 << 10, 64 << 10, 64 };
+        bool blocked = false;
+        for (int side = 64; side <= 1024; side *= 4) {
+                struct Plan plan = Plan_choose(&machine, side, side / 2, 12,
+                                               90);
+                A2 raster = plan.methods->new_with_blockshape(side,
+                        side / 2, 12, plan.blk_width, plan.blk_height);
+                assert(plan.map != NULL);
+                if (strcmp(plan.name, "block-major") == 0) {
+                        blocked = true;
+                        assert(plan.methods->map_block_major != NULL);
+                        assert(UArray2b_block_width(raster) ==
+                               plan.blk_width);
+                        assert(UArray2b_block_height(raster) ==
+                               plan.blk_height);
+                } else {
+                        assert(plan.methods == uarray2_methods_plain);
+                }
+                plan.methods->free(&raster);
+        }
+        assert(blocked);
+
+        /* A later plan of another shape leaves an earlier one intact */
+        struct Plan first = Plan_choose(&machine, 1024, 512, 12, 90);
+        struct Plan later = Plan_choose(&machine, 64, 4096, 4, 0);
+        assert(strcmp(first.name, "block-major") == 0);
+        assert(later.blk_width != first.blk_width ||
+               later.blk_height != first.blk_height);
+        A2 raster = first.methods->new_with_blockshape(1024, 512, 12,
+                first.blk_width, first.blk_height);
+        assert(UArray2b_block_width(raster) == first.blk_width);
+        assert(UArray2b_block_height(raster) == first.blk_height);
+        first.methods->free(&raster);
+}
+
+/* Splits a raster into line-aligned planes and interleaves it again on
+ * the way out, with one and two byte samples, in both plane layouts
+ */
+static void check_planar_write(void)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        int width = 19, height = 11;
+        A2 pixels = plain->new(width, height, sizeof(struct Pnm_rgb));
+        unsigned denominators[] = { 255, 1000 };
+
+        for (int d = 0; d < 2; d++) {
+                for (int j = 0; j < height; j++) {
+                        for (int i = 0; i < width; i++) {
+                                struct Pnm_rgb *pixel = plain->at(pixels, i,
+                                                                  j);
+                                pixel->red = (i * 37 + j) %
+                                             (denominators[d] + 1);
+                                pixel->green = (i + j * 53) %
+                                               (denominators[d] + 1);
+                                pixel->blue = i * j % (denominators[d] + 1);
+                        }
+                }
+                for (int blocksize = 1; blocksize <= 8; blocksize += 7) {
+                        Planar_T planar = Planar_new(width, height,
+                                                     blocksize);
+                        Planar_deinterleave(planar, plain, pixels);
+                        for (int p = PLANAR_RED; p <= PLANAR_BLUE; p++) {
+                                assert((uintptr_t) Planar_at(planar, p, 0,
+                                                             0) % 64 == 0);
+                        }
+
+                        char *output;
+                        size_t length;
+                        FILE *out = open_memstream(&output, &length);
+                        Planar_write(out, planar, denominators[d]);
+                        fclose(out);
+                        FILE *in = fmemopen(output, length, "rb");
+                        Pnm_ppm ppm = Pnm_ppmread(in, plain);
+                        assert(ppm->denominator == denominators[d]);
+                        for (int j = 0; j < height; j++) {
+                                for (int i = 0; i < width; i++) {
+                                        assert(memcmp(plain->at(ppm->pixels,
+                                                                i, j),
+                                                      plain->at(pixels, i, j),
+                                                      sizeof(struct Pnm_rgb))
+                                               == 0);
+                                }
+                        }
+                        Pnm_ppmfree(&ppm);
+                        fclose(in);
+                        free(output);
+                        Planar_free(&planar);
+                }
+        }
+        plain->free(&pixels);
+}
+
+struct visits {
+        int width, height;
+        int *seen;
+        int lookaheads;
+};
+
+static void visit_cell(int col, int row, UArray2b_T array, void *elem,
+                       void *cl)
+{
+        struct visits *visits = cl;
+        assert(elem == UArray2b_at(array, col, row));
+        visits->seen[row * visits->width + col]++;
+}
+
+static void look_ahead(int col, int row, int width, int height, void *cl)
+{
+        struct visits *visits = cl;
+        assert(col >= 0 && row >= 0 && width > 0 && height > 0);
+        assert(col + width <= visits->width &&
+               row + height <= visits->height);
+        visits->lookaheads++;
+}
+
+static void *read_counters(void *cl)
+{
+        struct Perf_counts counts;
+        *(bool *) cl = Perf_read(&counts);
+        return NULL;
+}
+
+/* A scheduled map visits every cell exactly once whatever the order and
+ * lookahead, and hardware counters belong to the thread that started
+ * them
+ */
+static void check_scheduled(void)
+{
+        int width = 37, height = 22;
+        UArray2b_T array = UArray2b_new(width, height, sizeof(int), 8);
+        int seen[width * height];
+        struct visits visits = { width, height, seen, 0 };
+
+        for (int serpentine = 0; serpentine <= 1; serpentine++) {
+                for (int distance = 0; distance <= 3; distance += 3) {
+                        memset(seen, 0, sizeof(seen));
+                        visits.lookaheads = 0;
+                        struct UArray2b_schedule schedule = {
+                                distance, serpentine,
+                                distance > 0 ? look_ahead : NULL, &visits
+                        };
+                        UArray2b_map_scheduled(array, &schedule, visit_cell,
+                                               &visits);
+                        for (int k = 0; k < width * height; k++) {
+                                assert(seen[k] == 1);
+                        }
+                        assert((visits.lookaheads > 0) == (distance > 0));
+                }
+        }
+        UArray2b_free(&array);
+
+        Perf_start();
+        Perf_stop();
+        bool counted = true;
+        pthread_t other;
+        pthread_create(&other, NULL, read_counters, &counted);
+        pthread_join(other, NULL);
+        assert(!counted);
+}
+
+static void traced_work(int thread, int first, int last, void *cl)
+{
+        (void) thread;
+        (void) first;
+        (void) last;
+        (void) cl;
+}
+
+/* Counts the spans named name in a summary, or -1 if there are none;
+ * the span totals follow every note
+ */
+static int span_count(const char *summary, const char *name)
+{
+        char key[64];
+        snprintf(key, sizeof(key), "\"%s\": {", name);
+        const char *spans = strstr(summary, "\"threads\": ");
+        assert(spans != NULL);
+        const char *at = strstr(spans, key);
+        long long ns;
+        int count;
+        if (at == NULL ||
+            sscanf(at + strlen(key), "\"ns\": %lld, \"count\": %d", &ns,
+                   &count) != 2) {
+                return -1;
+        }
+        return count;
+}
+
+/* Nested spans, spans on worker threads and notes all reach the
+ * summary; nothing is recorded before tracing is enabled
+ */
+static void check_trace(void)
+{
+        Trace_begin("early");
+        Trace_end();
+        Trace_enable();
+        Trace_note_num("cells", 12);
+        Trace_note_str("layout", "block-major");
+        Trace_begin("outer");
+        Trace_begin("inner");
+        Trace_end();
+        Trace_begin("inner");
+        Trace_end();
+        Trace_end();
+        Parallel_run(3, 3, traced_work, NULL);
+
+        char *summary;
+        size_t length;
+        FILE *out = open_memstream(&summary, &length);
+        Trace_write_summary(out);
+        fclose(out);
+        assert(strstr(summary, "\"cells\": 12, ") != NULL);
+        assert(strstr(summary, "\"layout\": \"block-major\", ") != NULL);
+        assert(span_count(summary, "outer") == 1);
+        assert(span_count(summary, "inner") == 2);
+        assert(span_count(summary, "worker") >= 1);
+        assert(span_count(summary, "early") == -1);
+        assert(summary[length - 1] == '\n');
+        free(summary);
+}
+
+/* Phases that run twice add up, and count the allocations made inside
+ * them; the report reaches the summary as the memory note
+ */
+static void check_memacct(void)
+{
+        assert(Trace_enabled());
+        assert(Mem_rss() > 0 && Mem_peak_rss() >= Mem_rss() / 2);
+        for (int run = 0; run < 2; run++) {
+                Mem_phase_begin("fill");
+                UArray2b_T array = UArray2b_new(40, 30, sizeof(int), 8);
+                *(int *) UArray2b_at(array, 0, 0) = 1;
+                *(int *) UArray2b_at(array, 39, 29) = 1;
+                UArray2b_free(&array);
+                Mem_phase_end(1000);
+        }
+        Mem_note();
+
+        char *summary;
+        size_t length;
+        FILE *out = open_memstream(&summary, &length);
+        Trace_write_summary(out);
+        fclose(out);
+        const char *memory = strstr(summary, "\"memory\": {\"rss_bytes\": ");
+        assert(memory != NULL);
+        const char *fill = strstr(memory, "\"fill\": {");
+        assert(fill != NULL);
+        long long ns;
+        int runs;
+        unsigned long long moved;
+        assert(sscanf(fill, "\"fill\": {\"ns\": %lld, \"runs\": %d, "
+                      "\"bytes_moved\": %llu", &ns, &runs, &moved) == 3);
+        assert(runs == 2 && moved == 2000);
+        const char *sites = strstr(fill, "\"allocations\": ");
+        int arrays, blocks;
+        assert(sites != NULL &&
+               sscanf(sites, "\"allocations\": {\"uarray2b_new\": "
+                      "{\"count\": %d, \"bytes\": %*u}, \"uarray_new\": "
+                      "{\"count\": %d", &arrays, &blocks) == 2);
+        assert(arrays == 2 && blocks == 4);
+        assert(span_count(summary, "fill") == 2);
+        free(summary);
+}
+
+/* Differential rotation check: every layout and fast path must agree
+ * with the rotate* callbacks mapped row-major over a plain raster
+ */
+
+/* Sizes always checked: degenerate, odd, around a block and one huge */
+static const struct {
+        int width, height;
+} fixed_dims[] = {
+        { 1, 1 }, { 1, 37 }, { 37, 1 }, { 2, 3 }, { W, H }, { 64, 64 },
+        { 65, 63 }, { 73, 146 }, { 2049, 1025 }
+};
+
+/* Random sizes checked after the fixed ones, each side 1 to MAX_RANDOM */
+#define NRANDOM 12
+#define MAX_RANDOM 300
+
+static const int angles[] = { 0, 90, 180, 270 };
+
+static int failures = 0;
+
+static A2Methods_applyfun *rotation_for(int angle)
+{
+        switch (angle) {
+        case 0:   return rotate0;
+        case 90:  return rotate90;
+        case 180: return rotate180;
+        default:  return rotate270;
+        }
+}
+
+static void fill_pixel(int i, int j, A2 a, void *elem, void *cl)
+{
+        struct Pnm_rgb *pixel = elem;
+        unsigned *seed = cl;
+        (void)i;
+        (void)j;
+        (void)a;
+        pixel->red = rand_r(seed) & 0xffff;
+        pixel->green = rand_r(seed) & 0xffff;
+        pixel->blue = rand_r(seed) & 0xffff;
+}
+
+struct copy {
+        A2Methods_T methods;
+        A2 dest;
+};
+
+static void copy_pixel(int i, int j, A2 a, void *elem, void *cl)
+{
+        struct copy *copy = cl;
+        (void)a;
+        *(struct Pnm_rgb *) copy->methods->at(copy->dest, i, j) =
+                *(struct Pnm_rgb *) elem;
+}
+
+/* source's pixels in a new array made by methods->new */
+static A2 copy_into(A2Methods_T methods, A2 source)
+{
+        struct copy copy = {
+                methods, methods->new(uarray2_methods_plain->width(source),
+                                      uarray2_methods_plain->height(source),
+                                      sizeof(struct Pnm_rgb))
+        };
+        uarray2_methods_plain->map_row_major(source, copy_pixel, &copy);
+        return copy.dest;
+}
+
+/* source (made by methods) rotated by angle with map and the callbacks */
+static A2 rotate_with(A2Methods_T methods, A2Methods_mapfun *map, A2 source,
+                      int angle)
+{
+        bool turns = angle == 90 || angle == 270;
+        int width = methods->width(source), height = methods->height(source);
+        struct closure cl = {
+                methods->new(turns ? height : width, turns ? width : height,
+                             sizeof(struct Pnm_rgb)),
+                methods
+        };
+        map(source, rotation_for(angle), &cl);
+        return cl.raster;
+}
+
+/* Order-independent checksum of every pixel and its position */
+static void accumulate_pixel(int i, int j, A2Methods_Object *ptr,
+                             void *partial, void *cl)
+{
+        struct Pnm_rgb *pixel = ptr;
+        (void)cl;
+        *(unsigned long long *) partial +=
+                (pixel->red * 3ULL + pixel->green * 5 + pixel->blue * 7) *
+                (i * 31ULL + j * 17 + 1);
+}
+
+static unsigned long long checksum(A2Methods_T methods, A2 array)
+{
+        unsigned long long zero = 0, sum;
+        methods->reduce(array, accumulate_pixel, merge_sums, &zero,
+                        sizeof(sum), &sum, NULL);
+        return sum;
+}
+
+static void fail(const char *what, int width, int height, int angle,
+                 const char *how, int i, int j)
+{
+        fprintf(stderr, "FAIL %s: %dx%d rotated %d: %s at (%d, %d)\n",
+                what, width, height, angle, how, i, j);
+        failures++;
+}
+
+/* Compares result, read through methods, cell by cell with expected, a
+ * plain raster, then checks its maps visit every cell and its reduce
+ * agrees with expected's
+ */
+static void compare(const char *what, int width, int height, int angle,
+                    A2Methods_T methods, A2 result, A2 expected)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        int w = plain->width(expected), h = plain->height(expected);
+        if (methods->width(result) != w || methods->height(result) != h) {
+                fail(what, width, height, angle, "wrong dimensions", -1, -1);
+                return;
+        }
+        for (int j = 0; j < h; j++) {
+                for (int i = 0; i < w; i++) {
+                        const void *cell = methods->get != NULL
+                                ? methods->get(result, i, j)
+                                : methods->at(result, i, j);
+                        if (memcmp(cell,
+                                   plain->at(expected, i, j),
+                                   sizeof(struct Pnm_rgb)) != 0) {
+                                fail(what, width, height, angle, "pixel",
+                                     i, j);
+                                return;
+                        }
+                }
+        }
+        long cells = 0;
+        methods->small_map_default(result, count_cell, &cells);
+        if (cells != (long) w * h) {
+                fail(what, width, height, angle, "small map count", -1, -1);
+        }
+        if (methods->reduce != NULL &&
+            checksum(methods, result) != checksum(plain, expected)) {
+                fail(what, width, height, angle, "reduce", -1, -1);
+        }
+}
+
+/* Checks the reference itself against Dihedral_point */
+static void check_reference(A2 source, A2 expected, int angle)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        int width = plain->width(source), height = plain->height(source);
+        Dihedral_T op = Dihedral_from_angle(angle);
+        for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                        int di, dj;
+                        Dihedral_point(op, width, height, i, j, &di, &dj);
+                        if (memcmp(plain->at(source, i, j),
+                                   plain->at(expected, di, dj),
+                                   sizeof(struct Pnm_rgb)) != 0) {
+                                fail("reference", width, height, angle,
+                                     "pixel", i, j);
+                                return;
+                        }
+                }
+        }
+}
+
+/* Checks a blocked suite's block-major and Hilbert maps and
+ * UArray2b_rotate
+ */
+static void check_blocked(const char *what, A2Methods_T methods, A2 source,
+                          A2 expected, int angle)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        int width = plain->width(source), height = plain->height(source);
+        char name[64];
+
+        A2 blocked = copy_into(methods, source);
+        A2 mapped = rotate_with(methods, methods->map_block_major, blocked,
+                                angle);
+        snprintf(name, sizeof(name), "%s block-major", what);
+        compare(name, width, height, angle, methods, mapped, expected);
+        methods->free(&mapped);
+
+        for (int cells = 0; cells <= 1; cells++) {
+                A2Blocked_set_hilbert_cells(cells);
+                mapped = rotate_with(methods, methods->map_hilbert, blocked,
+                                     angle);
+                snprintf(name, sizeof(name), "%s hilbert%s", what,
+                         cells ? " cells" : "");
+                compare(name, width, height, angle, methods, mapped,
+                        expected);
+                methods->free(&mapped);
+        }
+        A2Blocked_set_hilbert_cells(false);
+
+        A2 rotated = UArray2b_rotate(blocked, angle);
+        snprintf(name, sizeof(name), "%s UArray2b_rotate", what);
+        compare(name, width, height, angle, methods, rotated, expected);
+        methods->free(&rotated);
+        methods->free(&blocked);
+}
+
+/* Checks one planar layout against expected, plane by plane */
+static void check_planar(A2 source, A2 expected, int angle, int blocksize)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        int width = plain->width(source), height = plain->height(source);
+        Planar_T planar = Planar_new(width, height, blocksize);
+        Planar_deinterleave(planar, plain, source);
+        Planar_T rotated = Planar_rotate(planar, angle);
+
+        for (int j = 0; j < Planar_height(rotated); j++) {
+                for (int i = 0; i < Planar_width(rotated); i++) {
+                        struct Pnm_rgb *want = plain->at(expected, i, j);
+                        if (*Planar_at(rotated, PLANAR_RED, i, j) !=
+                            want->red ||
+                            *Planar_at(rotated, PLANAR_GREEN, i, j) !=
+                            want->green ||
+                            *Planar_at(rotated, PLANAR_BLUE, i, j) !=
+                            want->blue) {
+                                fail(blocksize == 1 ? "planar" :
+                                     "planar blocked", width, height, angle,
+                                     "pixel", i, j);
+                                j = Planar_height(rotated);
+                                break;
+                        }
+                }
+        }
+        Planar_free(&rotated);
+        Planar_free(&planar);
+}
+
+/**********check_rotations********
+ * Rotates a random width x height raster by every angle along every
+ * path and compares each result with the reference
+ ************************/
+static void check_rotations(int width, int height, unsigned seed)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+
+        for (size_t a = 0; a < sizeof(angles) / sizeof(int); a++) {
+                int angle = angles[a];
+                A2 source = plain->new(width, height, sizeof(struct Pnm_rgb));
+                plain->map_row_major(source, fill_pixel, &seed);
+                A2 expected = rotate_with(plain, plain->map_row_major,
+                                          source, angle);
+                check_reference(source, expected, angle);
+
+                A2 result = rotate_with(plain, plain->map_col_major, source,
+                                        angle);
+                compare("plain col-major", width, height, angle, plain,
+                        result, expected);
+                plain->free(&result);
+                result = rotate_with(plain, plain->map_hilbert, source,
+                                     angle);
+                compare("plain hilbert", width, height, angle, plain,
+                        result, expected);
+                plain->free(&result);
+
+                /* Both padding policies, for plain rows and blocks */
+                Padding_set(PADDING_NONE);
+                A2 packed = copy_into(plain, source);
+                result = rotate_with(plain, plain->map_row_major, packed,
+                                     angle);
+                compare("plain unpadded", width, height, angle, plain,
+                        result, expected);
+                plain->free(&result);
+                plain->free(&packed);
+                check_blocked("blocked unpadded", uarray2_methods_blocked,
+                              source, expected, angle);
+                Padding_set(PADDING_AUTO);
+
+                check_blocked("blocked 64KB", uarray2_methods_blocked,
+                              source, expected, angle);
+                A2Blocked_set_shape(4, 4);
+                check_blocked("blocked 4x4", uarray2_methods_blocked,
+                              source, expected, angle);
+                A2Blocked_set_shape(16, 3);
+                check_blocked("blocked 16x3", uarray2_methods_blocked,
+                              source, expected, angle);
+                A2Blocked_set_shape(0, 0);
+                check_blocked("compressed", uarray2_methods_compressed,
+                              source, expected, angle);
+
+                A2View_T view = A2View_transform(plain, source,
+                                                 Dihedral_from_angle(angle));
+                compare("view", width, height, angle, uarray2_methods_view,
+                        view, expected);
+                result = A2View_materialize(view, uarray2_methods_blocked);
+                compare("view materialized", width, height, angle,
+                        uarray2_methods_blocked, result, expected);
+                uarray2_methods_blocked->free(&result);
+                A2View_free(&view);
+
+                check_planar(source, expected, angle, 1);
+                check_planar(source, expected, angle, 8);
+
+                plain->free(&expected);
+                plain->free(&source);
+        }
+}
+
+/* Perf regression gate: ns per pixel of each configuration, best of
+ * PERF_RUNS rotations of a PERF_WIDTH x PERF_HEIGHT raster
+ */
+#define PERF_WIDTH 1500
+#define PERF_HEIGHT 1000
+#define PERF_RUNS 3
+
+struct perf {
+        char name[48];
+        double ns_per_pixel;
+};
+
+static double now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Best ns per pixel of rotating source by angle, through map when it is
+ * given and UArray2b_rotate otherwise
+ */
+static double time_rotation(A2Methods_T methods, A2Methods_mapfun *map,
+                            A2 source, int angle)
+{
+        double best = 0;
+        for (int run = 0; run < PERF_RUNS; run++) {
+                double start = now_ns();
+                A2 result = map != NULL ?
+                            rotate_with(methods, map, source, angle) :
+                            UArray2b_rotate(source, angle);
+                double ns = now_ns() - start;
+                methods->free(&result);
+                best = run == 0 || ns < best ? ns : best;
+        }
+        return best / ((double) PERF_WIDTH * PERF_HEIGHT);
+}
+
+/**********measure********
+ * Times every configuration, filling perfs
+ * Return: the number of configurations
+ ************************/
+static int measure(struct perf *perfs)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        A2Methods_T blocked = uarray2_methods_blocked;
+        unsigned seed = 1;
+        int n = 0;
+
+        A2 source = plain->new(PERF_WIDTH, PERF_HEIGHT,
+                               sizeof(struct Pnm_rgb));
+        plain->map_row_major(source, fill_pixel, &seed);
+        A2 blocks = copy_into(blocked, source);
+
+        for (size_t a = 1; a < sizeof(angles) / sizeof(int); a++) {
+                int angle = angles[a];
+                snprintf(perfs[n].name, sizeof(perfs[n].name),
+                         "plain-row-major-%d", angle);
+                perfs[n++].ns_per_pixel = time_rotation(plain,
+                        plain->map_row_major, source, angle);
+                snprintf(perfs[n].name, sizeof(perfs[n].name),
+                         "plain-col-major-%d", angle);
+                perfs[n++].ns_per_pixel = time_rotation(plain,
+                        plain->map_col_major, source, angle);
+                snprintf(perfs[n].name, sizeof(perfs[n].name),
+                         "blocked-block-major-%d", angle);
+                perfs[n++].ns_per_pixel = time_rotation(blocked,
+                        blocked->map_block_major, blocks, angle);
+                snprintf(perfs[n].name, sizeof(perfs[n].name),
+                         "plain-hilbert-%d", angle);
+                perfs[n++].ns_per_pixel = time_rotation(plain,
+                        plain->map_hilbert, source, angle);
+                snprintf(perfs[n].name, sizeof(perfs[n].name),
+                         "blocked-hilbert-%d", angle);
+                perfs[n++].ns_per_pixel = time_rotation(blocked,
+                        blocked->map_hilbert, blocks, angle);
+                snprintf(perfs[n].name, sizeof(perfs[n].name),
+                         "blocked-rotate-%d", angle);
+                perfs[n++].ns_per_pixel = time_rotation(blocked, NULL,
+                                                        blocks, angle);
+        }
+        blocked->free(&blocks);
+        plain->free(&source);
+        return n;
+}
+
+/**********perf_gate********
+ * Measures every configuration, then records the results to record_file
+ * and/or compares them with baseline_file, whose lines are
+ * "<name> <ns per pixel>" ('#' starts a comment)
+ * Inputs:
+ *              const char *baseline_file, *record_file: either may be NULL
+ *              double tolerance: allowed slowdown, as a fraction
+ * Return: number of configurations slower than baseline * (1 + tolerance)
+ ************************/
+static int perf_gate(const char *baseline_file, const char *record_file,
+                     double tolerance)
+{
+        struct perf perfs[32];
+        int n = measure(perfs);
+        int regressions = 0;
+
+        if (record_file != NULL) {
+                FILE *fp = fopen(record_file, "w");
+                if (fp == NULL) {
+                        fprintf(stderr, "cannot write %s\n", record_file);
+                        exit(1);
+                }
+                fprintf(fp, "# ns/pixel, %dx%d, best of %d\n", PERF_WIDTH,
+                        PERF_HEIGHT, PERF_RUNS);
+                for (int k = 0; k < n; k++) {
+                        fprintf(fp, "%s %.3f\n", perfs[k].name,
+                                perfs[k].ns_per_pixel);
+                }
+                fclose(fp);
+        }
+        if (baseline_file == NULL) {
+                return 0;
+        }
+
+        FILE *fp = fopen(baseline_file, "r");
+        if (fp == NULL) {
+                fprintf(stderr, "cannot read %s\n", baseline_file);
+                exit(1);
+        }
+        char line[128];
+        while (fgets(line, sizeof(line), fp) != NULL) {
+                char name[48];
+                double base;
+                if (line[0] == '#' ||
+                    sscanf(line, "%47s %lf", name, &base) != 2) {
+                        continue;
+                }
+                int k = 0;
+                while (k < n && strcmp(perfs[k].name, name) != 0) {
+                        k++;
+                }
+                if (k == n) {
+                        fprintf(stderr, "%s: not measured\n", name);
+                        continue;
+                }
+                bool slow = perfs[k].ns_per_pixel > base * (1 + tolerance);
+                printf("%-24s %8.2f ns/pixel, baseline %8.2f%s\n", name,
+                       perfs[k].ns_per_pixel, base,
+                       slow ? "  REGRESSED" : "");
+                regressions += slow;
+        }
+        fclose(fp);
+        return regressions;
+}
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-seed <n>] [-baseline <file> "
+                        "[-tolerance <percent>]] [-record <file>]\n",
+                        progname);
+        exit(1);
+}
+
 int main(int argc, char *argv[])
 {
-        assert(argc == 1);
-        (void)argv;
+        unsigned seed = 1;
+        const char *baseline_file = NULL, *record_file = NULL;
+        double tolerance = 0.20;
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+                        seed = strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "-baseline") == 0 &&
+                           i + 1 < argc) {
+                        baseline_file = argv[++i];
+                } else if (strcmp(argv[i], "-tolerance") == 0 &&
+                           i + 1 < argc) {
+                        tolerance = atof(argv[++i]) / 100;
+                } else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc) {
+                        record_file = argv[++i];
+                } else {
+                        usage(argv[0]);
+                }
+        }
+
         test_methods(uarray2_methods_plain);
-        /*  test_methods(uarray2_methods_blocked); */
+        check_codec();
+        check_compressed();
+        check_deferred();
+        check_copy();
+        check_views();
+        check_serve();
+        check_serve_run();
+        check_pool();
+        check_pipeline();
+        check_parallel();
+        check_planner();
+        check_planar_write();
+        check_scheduled();
+        check_trace();
+        check_memacct();
+
+        for (size_t k = 0; k < sizeof(fixed_dims) / sizeof(fixed_dims[0]);
+             k++) {
+                check_rotations(fixed_dims[k].width, fixed_dims[k].height,
+                                seed + k);
+        }
+        unsigned dims_seed = seed;
+        for (int k = 0; k < NRANDOM; k++) {
+                int width = rand_r(&dims_seed) % MAX_RANDOM + 1;
+                int height = rand_r(&dims_seed) % MAX_RANDOM + 1;
+                check_rotations(width, height, seed + k);
+        }
+        if (failures > 0) {
+                fprintf(stderr, "%d failures (seed %u)\n", failures, seed);
+                return 1;
+        }
+
+        /* Timing only when asked, so the default run stays a check */
+        if (baseline_file != NULL || record_file != NULL) {
+                int regressions = perf_gate(baseline_file, record_file,
+                                            tolerance);
+                if (regressions > 0) {
+                        fprintf(stderr, "%d regressions beyond %.0f%%\n",
+                                regressions, tolerance * 100);
+                        return 1;
+                }
+        }
         printf("Passed.\n");  /* only if we reach this point without
                                * assertion failure
                                */
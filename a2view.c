@@ -0,0 +1,323 @@
+/**************************************************************
+ *                     a2view.c
+ *
+ *     implementation of lazy views. Every dihedral transformation and
+ *     every crop sends view cells to raster cells by an integer affine
+ *     map, so a view keeps one origin and two unit steps, and a view
+ *     of a view composes into a single map of the original raster.
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "a2view.h"
+
+#define T A2View_T
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+struct T {
+        A2Methods_T methods;    /* suite of the raster underneath */
+        A2 base;                /* raster that holds the cells */
+        int width, height;      /* dimensions of the view */
+        int col0, row0;         /* base cell under view cell (0, 0) */
+        int col_dx, row_dx;     /* base step for one view column */
+        int col_dy, row_dy;     /* base step for one view row */
+};
+
+static T view_new(A2Methods_T methods, A2 array2, int width, int height,
+                  int col0, int row0, int col_dx, int row_dx,
+                  int col_dy, int row_dy);
+static const void *base_cell(T view, int col, int row);
+
+/**********A2View_transform********
+ * Creates a view of array2 rotated or reflected by op
+ * Inputs:
+ *              A2Methods_T methods: suite that reads array2
+ *              A2Methods_UArray2 array2: the raster (or view) to look at
+ *              Dihedral_T op: the pending transformation
+ * Return: a new view, to be released with A2View_free
+ * Expects: methods and array2 non NULL; array2 outlives the view
+ ************************/
+T A2View_transform(A2Methods_T methods, A2 array2, Dihedral_T op)
+{
+        assert(methods != NULL && array2 != NULL);
+        int width = methods->width(array2);
+        int height = methods->height(array2);
+        if (Dihedral_swaps_dims(op)) {
+                int tmp = width;
+                width = height;
+                height = tmp;
+        }
+
+        /* The inverse takes view cells back to array2 cells */
+        Dihedral_T back = Dihedral_inverse(op);
+        int col0, row0, col1, row1, col2, row2;
+        Dihedral_point(back, width, height, 0, 0, &col0, &row0);
+        Dihedral_point(back, width, height, 1, 0, &col1, &row1);
+        Dihedral_point(back, width, height, 0, 1, &col2, &row2);
+
+        return view_new(methods, array2, width, height, col0, row0,
+                        col1 - col0, row1 - row0, col2 - col0, row2 - row0);
+}
+
+/**********A2View_crop********
+ * Creates a view of a rectangle of array2
+ * Inputs:
+ *              A2Methods_T methods: suite that reads array2
+ *              A2Methods_UArray2 array2: the raster (or view) to look at
+ *              int col, row: top left cell of the rectangle
+ *              int width, height: dimensions of the rectangle
+ * Return: a new view, to be released with A2View_free
+ * Expects: a non empty rectangle inside array2
+ ************************/
+T A2View_crop(A2Methods_T methods, A2 array2, int col, int row, int width,
+              int height)
+{
+        assert(methods != NULL && array2 != NULL);
+        assert(col >= 0 && row >= 0 && width > 0 && height > 0);
+        assert(col + width <= methods->width(array2));
+        assert(row + height <= methods->height(array2));
+
+        return view_new(methods, array2, width, height, col, row,
+                        1, 0, 0, 1);
+}
+
+/**********A2View_free********
+ * Releases a view, leaving the raster underneath alone
+ * Inputs: pointer to the view
+ * Expects: view and *view non NULL
+ ************************/
+void A2View_free(T *view)
+{
+        assert(view != NULL && *view != NULL);
+        free(*view);
+        *view = NULL;
+}
+
+/**********A2View_materialize********
+ * Copies the cells seen through a view into a new raster
+ * Inputs:
+ *              A2View_T view: the view to copy
+ *              A2Methods_T methods: suite that makes the new raster
+ * Return: raster of the view's dimensions owned by the caller
+ * Expects: view non NULL, methods->new non NULL
+ ************************/
+A2 A2View_materialize(T view, A2Methods_T methods)
+{
+        assert(view != NULL && methods != NULL && methods->new != NULL);
+        int size = view->methods->size(view->base);
+        A2 raster = methods->new(view->width, view->height, size);
+
+        for (int y = 0; y < view->height; y++) {
+                int col = view->col0 + view->col_dy * y;
+                int row = view->row0 + view->row_dy * y;
+                for (int x = 0; x < view->width; x++) {
+                        memcpy(methods->at(raster, x, y),
+                               base_cell(view, col, row), size);
+                        col += view->col_dx;
+                        row += view->row_dx;
+                }
+        }
+        return raster;
+}
+
+/**********view_new********
+ * Builds a view from an affine map of view cells onto array2 cells,
+ * folding it into array2's own map when array2 is itself a view
+ * Inputs: the raster and its suite, the view dimensions, the array2 cell
+ *         under view cell (0, 0) and the array2 steps for one view
+ *         column and one view row
+ * Return: a new view
+ ************************/
+static T view_new(A2Methods_T methods, A2 array2, int width, int height,
+                  int col0, int row0, int col_dx, int row_dx,
+                  int col_dy, int row_dy)
+{
+        T view = malloc(sizeof(*view));
+        assert(view != NULL);
+        view->width = width;
+        view->height = height;
+
+        if (methods == uarray2_methods_view) {
+                /* Pushes the map through the inner view's map */
+                T inner = array2;
+                view->methods = inner->methods;
+                view->base = inner->base;
+                view->col0 = inner->col0 + inner->col_dx * col0
+                             + inner->col_dy * row0;
+                view->row0 = inner->row0 + inner->row_dx * col0
+                             + inner->row_dy * row0;
+                view->col_dx = inner->col_dx * col_dx + inner->col_dy * row_dx;
+                view->row_dx = inner->row_dx * col_dx + inner->row_dy * row_dx;
+                view->col_dy = inner->col_dx * col_dy + inner->col_dy * row_dy;
+                view->row_dy = inner->row_dx * col_dy + inner->row_dy * row_dy;
+        } else {
+                view->methods = methods;
+                view->base = array2;
+                view->col0 = col0;
+                view->row0 = row0;
+                view->col_dx = col_dx;
+                view->row_dx = row_dx;
+                view->col_dy = col_dy;
+                view->row_dy = row_dy;
+        }
+        return view;
+}
+
+/**********base_cell********
+ * Reads a cell of the raster under a view without writing to it, so
+ * blocks a blocked raster never touched stay unallocated and blocks it
+ * shares stay shared
+ ************************/
+static const void *base_cell(T view, int col, int row)
+{
+        if (view->methods->get != NULL) {
+                return view->methods->get(view->base, col, row);
+        }
+        return view->methods->at(view->base, col, row);
+}
+
+/************************************************/
+/* Private versions of the A2Methods_T functions */
+/************************************************/
+
+static void a2free(A2 *array2p)
+{
+        A2View_free((T *) array2p);
+}
+
+static int width(A2 array2)
+{
+        T view = array2;
+        return view->width;
+}
+
+static int height(A2 array2)
+{
+        T view = array2;
+        return view->height;
+}
+
+static int size(A2 array2)
+{
+        T view = array2;
+        return view->methods->size(view->base);
+}
+
+static int blocksize(A2 array2)
+{
+        (void) array2;
+        return 1;
+}
+
+static const A2Methods_Object *get(A2 array2, int i, int j)
+{
+        T view = array2;
+        assert(i >= 0 && i < view->width);
+        assert(j >= 0 && j < view->height);
+        return base_cell(view,
+                view->col0 + view->col_dx * i + view->col_dy * j,
+                view->row0 + view->row_dx * i + view->row_dy * j);
+}
+
+/**********at********
+ * Views are read-only: a write through one would land in the raster
+ * underneath, and for a blocked raster in a block it may share, so
+ * asking a view for a writable cell is a checked runtime error.
+ * Read cells with get.
+ ************************/
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+        (void) array2;
+        (void) i;
+        (void) j;
+        fprintf(stderr, "A2View: views are read-only, read cells with get\n");
+        assert(0);
+        return NULL;
+}
+
+/* The map functions hand cells out through A2Methods_applyfun, whose
+ * elem is not const; apply must only read them
+ */
+static A2Methods_Object *cell(A2 array2, int i, int j)
+{
+        return (A2Methods_Object *) get(array2, i, j);
+}
+
+static void map_row_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        T view = array2;
+        for (int j = 0; j < view->height; j++) {
+                for (int i = 0; i < view->width; i++) {
+                        apply(i, j, array2, cell(array2, i, j), cl);
+                }
+        }
+}
+
+static void map_col_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        T view = array2;
+        for (int i = 0; i < view->width; i++) {
+                for (int j = 0; j < view->height; j++) {
+                        apply(i, j, array2, cell(array2, i, j), cl);
+                }
+        }
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void *cl;
+};
+
+static void apply_small(int i, int j, A2 array2, void *elem, void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)array2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_row_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_row_major(a2, apply_small, &mycl);
+}
+
+static void small_map_col_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_col_major(a2, apply_small, &mycl);
+}
+
+static struct A2Methods_T uarray2_methods_view_struct = {
+        NULL,                   // new
+        NULL,                   // new_with_blocksize
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        map_row_major,
+        map_col_major,
+        NULL,                   // map_block_major
+        map_row_major,          // map_default
+        small_map_row_major,
+        small_map_col_major,
+        NULL,                   // small_map_block_major
+        small_map_row_major,    // small_map_default
+        NULL,                   // reduce
+        NULL,                   // new_with_blockshape
+        NULL,                   // map_hilbert
+        NULL,                   // small_map_hilbert
+        get,
+};
+
+A2Methods_T uarray2_methods_view = &uarray2_methods_view_struct;
@@ -0,0 +1,38 @@
+/**************************************************************
+ *                     a2view.h
+ *
+ *     interface for lazy views: a raster seen through a pending
+ *     rotation, reflection or crop. Views implement A2Methods_T, so
+ *     anything that reads a raster (Pnm_ppmwrite included) can read
+ *     a view, and no cells are copied until someone asks for them.
+ *
+ **************************************************************/
+#ifndef A2VIEW_INCLUDED
+#define A2VIEW_INCLUDED
+
+#include "a2methods.h"
+#include "dihedral.h"
+
+#define T A2View_T
+typedef struct T *T;
+
+/* suite for reading views; new and new_with_blocksize are NULL,
+ * free releases only the view, never the raster underneath, and at is
+ * a checked runtime error: cells are read with get
+ */
+extern A2Methods_T uarray2_methods_view;
+
+/* array2 is read through methods; it may itself be a view, in which
+ * case the two are folded into one view of the raster underneath
+ */
+extern T    A2View_transform(A2Methods_T methods, A2Methods_UArray2 array2,
+                             Dihedral_T op);
+extern T    A2View_crop(A2Methods_T methods, A2Methods_UArray2 array2,
+                        int col, int row, int width, int height);
+extern void A2View_free(T *view);
+
+/* copies the cells of view into a new raster made by methods */
+extern A2Methods_UArray2 A2View_materialize(T view, A2Methods_T methods);
+
+#undef T
+#endif
@@ -0,0 +1,146 @@
+/**************************************************************
+ *                     blockcodec.c
+ *
+ *     implementation of the block codec. Runs are counted in whole
+ *     elements, so a block of identical pixels packs to one element
+ *     no matter how large the block is.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "assert.h"
+#include "blockcodec.h"
+
+/* Bytes used to store the length of one run */
+#define RUN_BYTES ((int) sizeof(uint32_t))
+
+static int count_runs(const unsigned char *elems, int nelems, int size);
+
+/**********Codec_encode********
+ * Packs nelems elements of the given size into a freshly allocated byte
+ * string, choosing the smallest of the three encodings
+ * Inputs:
+ *              const void *elems: the elements to pack
+ *              int nelems: number of elements
+ *              int size: bytes per element
+ *              unsigned char **packed: set to the malloc'd packed bytes
+ *              int *nbytes: set to the length of *packed
+ * Return: the CODEC_ kind used
+ * Expects: elems, packed and nbytes non NULL, nelems and size positive
+ ************************/
+int Codec_encode(const void *elems, int nelems, int size,
+                 unsigned char **packed, int *nbytes)
+{
+        assert(elems != NULL && packed != NULL && nbytes != NULL);
+        assert(nelems > 0 && size > 0);
+
+        const unsigned char *bytes = elems;
+        int runs = count_runs(bytes, nelems, size);
+        long rle_bytes = (long) runs * (RUN_BYTES + size);
+        long raw_bytes = (long) nelems * size;
+
+        /* One run: the block is a single colour */
+        if (runs == 1) {
+                *nbytes = size;
+                *packed = malloc(size);
+                assert(*packed != NULL);
+                memcpy(*packed, bytes, size);
+                return CODEC_UNIFORM;
+        }
+        /* Runs too short to pay for their lengths */
+        if (rle_bytes >= raw_bytes) {
+                *nbytes = raw_bytes;
+                *packed = malloc(raw_bytes);
+                assert(*packed != NULL);
+                memcpy(*packed, bytes, raw_bytes);
+                return CODEC_VERBATIM;
+        }
+
+        *nbytes = rle_bytes;
+        *packed = malloc(rle_bytes);
+        assert(*packed != NULL);
+        unsigned char *out = *packed;
+        int i = 0;
+        while (i < nelems) {
+                const unsigned char *elem = bytes + (long) i * size;
+                uint32_t run = 1;
+                while (i + (int) run < nelems &&
+                       memcmp(elem + (long) run * size, elem, size) == 0) {
+                        run++;
+                }
+                memcpy(out, &run, RUN_BYTES);
+                memcpy(out + RUN_BYTES, elem, size);
+                out += RUN_BYTES + size;
+                i += run;
+        }
+        return CODEC_RLE;
+}
+
+/**********Codec_decode********
+ * Expands a packed byte string back into nelems elements
+ * Inputs:
+ *              int kind: the CODEC_ kind returned by Codec_encode
+ *              const unsigned char *packed: the packed bytes
+ *              int nbytes: length of packed
+ *              void *elems: destination with room for nelems elements
+ *              int nelems: number of elements
+ *              int size: bytes per element
+ * Return: N/A
+ * Expects: packed was produced by Codec_encode with the same nelems
+ *          and size
+ ************************/
+void Codec_decode(int kind, const unsigned char *packed, int nbytes,
+                  void *elems, int nelems, int size)
+{
+        assert(packed != NULL && elems != NULL);
+        unsigned char *out = elems;
+
+        switch (kind) {
+        case CODEC_UNIFORM:
+                for (int i = 0; i < nelems; i++) {
+                        memcpy(out + (long) i * size, packed, size);
+                }
+                break;
+        case CODEC_VERBATIM:
+                assert(nbytes == nelems * size);
+                memcpy(out, packed, nbytes);
+                break;
+        case CODEC_RLE: {
+                const unsigned char *in = packed;
+                const unsigned char *end = packed + nbytes;
+                while (in < end) {
+                        uint32_t run;
+                        memcpy(&run, in, RUN_BYTES);
+                        for (uint32_t k = 0; k < run; k++) {
+                                memcpy(out, in + RUN_BYTES, size);
+                                out += size;
+                        }
+                        in += RUN_BYTES + size;
+                }
+                assert(out == (unsigned char *) elems + (long) nelems * size);
+                break;
+        }
+        default:
+                assert(0);
+        }
+}
+
+/**********count_runs********
+ * Counts the maximal runs of equal elements
+ * Inputs: the elements, how many there are and bytes per element
+ * Return: number of runs (at least 1)
+ * Expects: nelems positive
+ ************************/
+static int count_runs(const unsigned char *elems, int nelems, int size)
+{
+        int runs = 1;
+        for (int i = 1; i < nelems; i++) {
+                if (memcmp(elems + (long) i * size,
+                           elems + (long) (i - 1) * size, size) != 0) {
+                        runs++;
+                }
+        }
+        return runs;
+}
@@ -0,0 +1,23 @@
+/**************************************************************
+ *                     blockcodec.h
+ *
+ *     interface for packing the elements of one block into a
+ *     compact byte string (uniform marker, run-length, or verbatim)
+ *
+ **************************************************************/
+#ifndef BLOCKCODEC_INCLUDED
+#define BLOCKCODEC_INCLUDED
+
+/* How a packed block is encoded */
+enum {
+        CODEC_UNIFORM = 1,      /* a single element repeated everywhere */
+        CODEC_RLE,              /* (run length, element) pairs */
+        CODEC_VERBATIM          /* elements copied as is */
+};
+
+extern int  Codec_encode(const void *elems, int nelems, int size,
+                         unsigned char **packed, int *nbytes);
+extern void Codec_decode(int kind, const unsigned char *packed, int nbytes,
+                         void *elems, int nelems, int size);
+
+#endif
@@ -0,0 +1,128 @@
+/**************************************************************
+ *                     dihedral.c
+ *
+ *     implementation of the raster rotations and reflections
+ *
+ **************************************************************/
+
+#include "assert.h"
+#include "dihedral.h"
+
+/**********Dihedral_from_angle********
+ * Returns the rotation for a clockwise angle in degrees
+ * Inputs: int angle: 0, 90, 180 or 270
+ * Return: the matching Dihedral_T
+ * Expects: angle is one of the four listed
+ ************************/
+Dihedral_T Dihedral_from_angle(int angle)
+{
+        assert(angle == 0 || angle == 90 || angle == 180 || angle == 270);
+        return (Dihedral_T) (DIHEDRAL_ROT0 + angle / 90);
+}
+
+/**********Dihedral_swaps_dims********
+ * Returns true when op turns a width x height raster into a
+ * height x width one
+ ************************/
+bool Dihedral_swaps_dims(Dihedral_T op)
+{
+        return op == DIHEDRAL_ROT90 || op == DIHEDRAL_ROT270
+                || op == DIHEDRAL_TRANSPOSE || op == DIHEDRAL_TRANSVERSE;
+}
+
+/**********Dihedral_inverse********
+ * Returns the transformation that undoes op
+ * Inputs: Dihedral_T op: the transformation
+ * Return: op for every reflection and for 0 and 180; 90 and 270 swap
+ ************************/
+Dihedral_T Dihedral_inverse(Dihedral_T op)
+{
+        if (op == DIHEDRAL_ROT90) {
+                return DIHEDRAL_ROT270;
+        }
+        if (op == DIHEDRAL_ROT270) {
+                return DIHEDRAL_ROT90;
+        }
+        return op;
+}
+
+/**********Dihedral_point********
+ * Computes where the source cell (col, row) lands after op
+ * Inputs:
+ *              Dihedral_T op: the transformation
+ *              int width, height: dimensions of the source raster
+ *              int col, row: a cell of the source raster
+ *              int *dcol, *drow: set to the destination cell
+ * Return: N/A
+ * Expects: (col, row) in bounds, dcol and drow non NULL
+ ************************/
+void Dihedral_point(Dihedral_T op, int width, int height,
+                    int col, int row, int *dcol, int *drow)
+{
+        assert(dcol != NULL && drow != NULL);
+
+        switch (op) {
+        case DIHEDRAL_ROT0:
+                *dcol = col;
+                *drow = row;
+                break;
+        case DIHEDRAL_ROT90:
+                *dcol = height - row - 1;
+                *drow = col;
+                break;
+        case DIHEDRAL_ROT180:
+                *dcol = width - col - 1;
+                *drow = height - row - 1;
+                break;
+        case DIHEDRAL_ROT270:
+                *dcol = row;
+                *drow = width - col - 1;
+                break;
+        case DIHEDRAL_FLIP_H:
+                *dcol = width - col - 1;
+                *drow = row;
+                break;
+        case DIHEDRAL_FLIP_V:
+                *dcol = col;
+                *drow = height - row - 1;
+                break;
+        case DIHEDRAL_TRANSPOSE:
+                *dcol = row;
+                *drow = col;
+                break;
+        case DIHEDRAL_TRANSVERSE:
+                *dcol = height - row - 1;
+                *drow = width - col - 1;
+                break;
+        default:
+                assert(0);
+        }
+}
+
+/**********Dihedral_rect********
+ * Maps a rectangle of the source raster to the rectangle it covers
+ * after op, updating it in place
+ * Inputs:
+ *              Dihedral_T op: the transformation
+ *              int width, height: dimensions of the source raster
+ *              int *col, *row: top left cell of the rectangle
+ *              int *w, *h: dimensions of the rectangle
+ * Return: N/A
+ * Expects: the rectangle is non empty and lies inside the source
+ ************************/
+void Dihedral_rect(Dihedral_T op, int width, int height,
+                   int *col, int *row, int *w, int *h)
+{
+        assert(*w > 0 && *h > 0);
+        int c0, r0, c1, r1;
+
+        /* Opposite corners land on opposite corners */
+        Dihedral_point(op, width, height, *col, *row, &c0, &r0);
+        Dihedral_point(op, width, height, *col + *w - 1, *row + *h - 1,
+                       &c1, &r1);
+
+        *col = c0 < c1 ? c0 : c1;
+        *row = r0 < r1 ? r0 : r1;
+        *w = (c0 < c1 ? c1 - c0 : c0 - c1) + 1;
+        *h = (r0 < r1 ? r1 - r0 : r0 - r1) + 1;
+}
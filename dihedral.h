@@ -0,0 +1,34 @@
+/**************************************************************
+ *                     dihedral.h
+ *
+ *     interface for the eight rotations and reflections of a raster
+ *     and the coordinate arithmetic they imply
+ *
+ **************************************************************/
+#ifndef DIHEDRAL_INCLUDED
+#define DIHEDRAL_INCLUDED
+
+#include <stdbool.h>
+
+typedef enum {
+        DIHEDRAL_ROT0 = 0,
+        DIHEDRAL_ROT90,
+        DIHEDRAL_ROT180,
+        DIHEDRAL_ROT270,
+        DIHEDRAL_FLIP_H,        /* mirror left to right */
+        DIHEDRAL_FLIP_V,        /* mirror top to bottom */
+        DIHEDRAL_TRANSPOSE,     /* across the main diagonal */
+        DIHEDRAL_TRANSVERSE     /* across the anti-diagonal */
+} Dihedral_T;
+
+extern Dihedral_T Dihedral_from_angle(int angle);
+extern bool       Dihedral_swaps_dims(Dihedral_T op);
+extern Dihedral_T Dihedral_inverse(Dihedral_T op);
+
+/* width and height are those of the source raster */
+extern void Dihedral_point(Dihedral_T op, int width, int height,
+                           int col, int row, int *dcol, int *drow);
+extern void Dihedral_rect(Dihedral_T op, int width, int height,
+                          int *col, int *row, int *w, int *h);
+
+#endif
@@ -0,0 +1,110 @@
+/**************************************************************
+ *                     hilbert.c
+ *
+ *     implementation of Hilbert-order walks with the "gilbert"
+ *     generalization of the curve to rectangles (J. Cerveny). A
+ *     rectangle is given by its corner and two vectors, a along its
+ *     major side and b along the other; it is split into two or three
+ *     smaller rectangles, each walked with its own orientation.
+ *
+ **************************************************************/
+#include <stdlib.h>
+
+#include "assert.h"
+#include "hilbert.h"
+
+static void walk(int x, int y, int ax, int ay, int bx, int by,
+                 Hilbert_visit *visit, void *cl);
+static int sign(int v);
+static int half(int v);
+
+/**********Hilbert_walk********
+ * Visits every cell of a width x height grid along a Hilbert curve
+ * Inputs:
+ *              int width, height: dimensions of the grid, either may be 0
+ *              visit: called with each cell's column and row, and cl
+ *              void *cl: passed through to visit
+ * Return: N/A
+ * Expects: width and height non-negative
+ ************************/
+void Hilbert_walk(int width, int height, Hilbert_visit *visit, void *cl)
+{
+        assert(width >= 0 && height >= 0 && visit != NULL);
+        if (width == 0 || height == 0) {
+                return;
+        }
+        /* The curve runs along the longer side */
+        if (width >= height) {
+                walk(0, 0, width, 0, 0, height, visit, cl);
+        } else {
+                walk(0, 0, 0, height, width, 0, visit, cl);
+        }
+}
+
+/**********walk********
+ * Walks the rectangle with corner (x, y), major side (ax, ay) and minor
+ * side (bx, by), ending next to the far end of the major side
+ ************************/
+static void walk(int x, int y, int ax, int ay, int bx, int by,
+                 Hilbert_visit *visit, void *cl)
+{
+        int w = abs(ax + ay), h = abs(bx + by);
+        int dax = sign(ax), day = sign(ay);     /* unit major step */
+        int dbx = sign(bx), dby = sign(by);     /* unit minor step */
+
+        /* A single line is walked straight along */
+        if (h == 1) {
+                for (int i = 0; i < w; i++, x += dax, y += day) {
+                        visit(x, y, cl);
+                }
+                return;
+        }
+        if (w == 1) {
+                for (int i = 0; i < h; i++, x += dbx, y += dby) {
+                        visit(x, y, cl);
+                }
+                return;
+        }
+
+        int ax2 = half(ax), ay2 = half(ay);
+        int bx2 = half(bx), by2 = half(by);
+        int w2 = abs(ax2 + ay2), h2 = abs(bx2 + by2);
+
+        if (2 * w > 3 * h) {
+                /* Long and thin: two halves along the major side, with
+                 * an even first half so the join is a unit step
+                 */
+                if (w2 % 2 != 0 && w > 2) {
+                        ax2 += dax;
+                        ay2 += day;
+                }
+                walk(x, y, ax2, ay2, bx, by, visit, cl);
+                walk(x + ax2, y + ay2, ax - ax2, ay - ay2, bx, by, visit,
+                     cl);
+        } else {
+                /* Up the first half of the minor side, along the major
+                 * side, and back down
+                 */
+                if (h2 % 2 != 0 && h > 2) {
+                        bx2 += dbx;
+                        by2 += dby;
+                }
+                walk(x, y, bx2, by2, ax2, ay2, visit, cl);
+                walk(x + bx2, y + by2, ax, ay, bx - bx2, by - by2, visit,
+                     cl);
+                walk(x + (ax - dax) + (bx2 - dbx),
+                     y + (ay - day) + (by2 - dby),
+                     -bx2, -by2, -(ax - ax2), -(ay - ay2), visit, cl);
+        }
+}
+
+static int sign(int v)
+{
+        return (v > 0) - (v < 0);
+}
+
+/* v / 2 rounded toward minus infinity, as the curve's splits need */
+static int half(int v)
+{
+        return v >= 0 ? v / 2 : -((1 - v) / 2);
+}
@@ -0,0 +1,22 @@
+/**************************************************************
+ *                     hilbert.h
+ *
+ *     interface for Hilbert-order walks over grids of any shape. Cells
+ *     next to each other in the walk are next to each other in the
+ *     grid, so a walk keeps both the cells it reads and the rotated
+ *     cells it writes close together in either direction.
+ *
+ **************************************************************/
+#ifndef HILBERT_INCLUDED
+#define HILBERT_INCLUDED
+
+typedef void Hilbert_visit(int col, int row, void *cl);
+
+/* Calls visit on every cell of a width x height grid once, along a
+ * generalized Hilbert curve from (0, 0). Steps are between neighbours,
+ * except for one diagonal step in some grids with an odd side.
+ */
+extern void Hilbert_walk(int width, int height, Hilbert_visit *visit,
+                         void *cl);
+
+#endif
@@ -0,0 +1,237 @@
+/**************************************************************
+ *                     memacct.c
+ *
+ *     implementation of memory accounting. Site counters are atomics,
+ *     always kept since they cost far less than the allocations they
+ *     count; phase records are only kept while tracing is on. Peak RSS
+ *     comes from getrusage and current RSS from /proc/self/statm.
+ *
+ **************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "memacct.h"
+#include "trace.h"
+
+#define MAX_DEPTH 16
+#define MAX_PHASES 32
+
+static const char *site_names[MEM_NSITES] = {
+        "uarray2b_new", "uarray_new", "cl_maker"
+};
+
+static unsigned long long counts[MEM_NSITES];
+static unsigned long long bytes[MEM_NSITES];
+
+/* What a phase has done over all its runs */
+struct phase {
+        const char *name;
+        int runs;
+        long long ns;
+        unsigned long long allocs[MEM_NSITES], alloc_bytes[MEM_NSITES];
+        unsigned long long moved;
+        size_t rss, peak_rss;   /* at the end of the latest run */
+};
+
+/* Counters when an open phase began */
+struct mark {
+        const char *name;
+        long long start;
+        unsigned long long allocs[MEM_NSITES], alloc_bytes[MEM_NSITES];
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct phase phases[MAX_PHASES];
+static int nphases = 0;
+static __thread struct mark open[MAX_DEPTH];
+static __thread int depth = 0;
+
+static long long now(void);
+static void snapshot(unsigned long long *allocs, unsigned long long *nbytes);
+static void write_sites(FILE *fp, const unsigned long long *allocs,
+                        const unsigned long long *nbytes);
+
+/**********Mem_count********
+ * Counts one allocation
+ * Inputs:
+ *              enum Mem_site site: where it was made
+ *              size_t bytes: how large it is
+ ************************/
+void Mem_count(enum Mem_site site, size_t nbytes)
+{
+        assert(site < MEM_NSITES);
+        __atomic_fetch_add(&counts[site], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&bytes[site], nbytes, __ATOMIC_RELAXED);
+}
+
+/**********Mem_rss********
+ * Returns the resident set size, from the second field of statm
+ ************************/
+size_t Mem_rss(void)
+{
+        FILE *fp = fopen("/proc/self/statm", "r");
+        if (fp == NULL) {
+                return 0;
+        }
+        unsigned long size, resident;
+        int got = fscanf(fp, "%lu %lu", &size, &resident);
+        fclose(fp);
+        if (got != 2) {
+                return 0;
+        }
+        return (size_t) resident * sysconf(_SC_PAGESIZE);
+}
+
+/**********Mem_peak_rss********
+ * Returns the largest resident set size so far (ru_maxrss is in KB)
+ ************************/
+size_t Mem_peak_rss(void)
+{
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+                return 0;
+        }
+        return (size_t) usage.ru_maxrss * 1024;
+}
+
+/**********Mem_phase_begin********
+ * Opens a trace span and marks the allocation counters
+ ************************/
+void Mem_phase_begin(const char *name)
+{
+        Trace_begin(name);
+        if (!Trace_enabled()) {
+                return;
+        }
+        assert(depth < MAX_DEPTH);
+        struct mark *mark = &open[depth++];
+        mark->name = name;
+        snapshot(mark->allocs, mark->alloc_bytes);
+        mark->start = now();
+}
+
+/**********Mem_phase_end********
+ * Closes the innermost phase and adds what it did to its record
+ * Inputs: size_t bytes_moved: bytes the phase read plus wrote
+ ************************/
+void Mem_phase_end(size_t bytes_moved)
+{
+        Trace_end();
+        if (!Trace_enabled() || depth == 0) {
+                return;
+        }
+        struct mark *mark = &open[--depth];
+        long long ns = now() - mark->start;
+        unsigned long long allocs[MEM_NSITES], alloc_bytes[MEM_NSITES];
+        snapshot(allocs, alloc_bytes);
+        size_t rss = Mem_rss(), peak_rss = Mem_peak_rss();
+
+        pthread_mutex_lock(&lock);
+        int i;
+        for (i = 0; i < nphases && strcmp(phases[i].name, mark->name) != 0;
+             i++) {
+        }
+        if (i < MAX_PHASES) {
+                if (i == nphases) {
+                        nphases++;
+                        memset(&phases[i], 0, sizeof(phases[i]));
+                        phases[i].name = mark->name;
+                }
+                phases[i].runs++;
+                phases[i].ns += ns;
+                for (int s = 0; s < MEM_NSITES; s++) {
+                        phases[i].allocs[s] += allocs[s] - mark->allocs[s];
+                        phases[i].alloc_bytes[s] += alloc_bytes[s] -
+                                                    mark->alloc_bytes[s];
+                }
+                phases[i].moved += bytes_moved;
+                phases[i].rss = rss;
+                phases[i].peak_rss = peak_rss;
+        }
+        pthread_mutex_unlock(&lock);
+}
+
+/**********Mem_note********
+ * Builds the report as a JSON object and notes it in the trace
+ ************************/
+void Mem_note(void)
+{
+        if (!Trace_enabled()) {
+                return;
+        }
+        char *json;
+        size_t length;
+        FILE *fp = open_memstream(&json, &length);
+        assert(fp != NULL);
+
+        unsigned long long allocs[MEM_NSITES], alloc_bytes[MEM_NSITES];
+        snapshot(allocs, alloc_bytes);
+        fprintf(fp, "{\"rss_bytes\": %zu, \"peak_rss_bytes\": %zu, "
+                "\"allocations\": ", Mem_rss(), Mem_peak_rss());
+        write_sites(fp, allocs, alloc_bytes);
+        fprintf(fp, ", \"phases\": {");
+
+        pthread_mutex_lock(&lock);
+        for (int i = 0; i < nphases; i++) {
+                struct phase *p = &phases[i];
+                fprintf(fp, "%s\"%s\": {\"ns\": %lld, \"runs\": %d, "
+                        "\"bytes_moved\": %llu, \"bytes_per_s\": %.0f, "
+                        "\"rss_bytes\": %zu, \"peak_rss_bytes\": %zu, "
+                        "\"allocations\": ", i == 0 ? "" : ", ", p->name,
+                        p->ns, p->runs, p->moved,
+                        p->ns > 0 ? p->moved * 1e9 / p->ns : 0.0, p->rss,
+                        p->peak_rss);
+                write_sites(fp, p->allocs, p->alloc_bytes);
+                fprintf(fp, "}");
+        }
+        pthread_mutex_unlock(&lock);
+        fprintf(fp, "}}");
+        fclose(fp);
+
+        Trace_note_json("memory", json);
+        free(json);
+}
+
+/**********now********
+ * Monotonic time in ns
+ ************************/
+static long long now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**********snapshot********
+ * Copies the counters of every site
+ ************************/
+static void snapshot(unsigned long long *allocs, unsigned long long *nbytes)
+{
+        for (int s = 0; s < MEM_NSITES; s++) {
+                allocs[s] = __atomic_load_n(&counts[s], __ATOMIC_RELAXED);
+                nbytes[s] = __atomic_load_n(&bytes[s], __ATOMIC_RELAXED);
+        }
+}
+
+/**********write_sites********
+ * Writes the count and bytes of each site as a JSON object. Sites are
+ * not summed: a blocked raster from cl_maker is also a UArray2b_new.
+ ************************/
+static void write_sites(FILE *fp, const unsigned long long *allocs,
+                        const unsigned long long *nbytes)
+{
+        fprintf(fp, "{");
+        for (int s = 0; s < MEM_NSITES; s++) {
+                fprintf(fp, "%s\"%s\": {\"count\": %llu, \"bytes\": %llu}",
+                        s == 0 ? "" : ", ", site_names[s], allocs[s],
+                        nbytes[s]);
+        }
+        fprintf(fp, "}");
+}
@@ -0,0 +1,40 @@
+/**************************************************************
+ *                     memacct.h
+ *
+ *     interface for memory accounting: allocation counts by site,
+ *     resident set size, and per phase the allocations made, the RSS
+ *     reached and the bytes moved per second. Phases are trace spans,
+ *     so accounting is on exactly when tracing is.
+ *
+ **************************************************************/
+#ifndef MEMACCT_INCLUDED
+#define MEMACCT_INCLUDED
+
+#include <stddef.h>
+
+/* Where allocations are counted */
+enum Mem_site {
+        MEM_UARRAY2B_NEW,       /* a blocked array and its block table */
+        MEM_UARRAY_NEW,         /* the cells of one block */
+        MEM_CL_MAKER,           /* a destination raster, at full size */
+        MEM_NSITES
+};
+
+/* Counts one allocation of bytes at site; safe from any thread */
+extern void Mem_count(enum Mem_site site, size_t bytes);
+
+/* Resident set size now and at its peak, in bytes; 0 if unknown */
+extern size_t Mem_rss(void);
+extern size_t Mem_peak_rss(void);
+
+/* Brackets a phase of the calling thread, as Trace_begin and Trace_end
+ * do. bytes_moved is what the phase read plus what it wrote, from which
+ * its bandwidth is worked out; name must outlive the report.
+ */
+extern void Mem_phase_begin(const char *name);
+extern void Mem_phase_end(size_t bytes_moved);
+
+/* Adds the report to the trace summary as the "memory" note */
+extern void Mem_note(void);
+
+#endif
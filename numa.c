@@ -0,0 +1,232 @@
+/**************************************************************
+ *                     numa.c
+ *
+ *     implementation of NUMA placement on Linux, using the raw mbind
+ *     system call so no libnuma is needed
+ *
+ **************************************************************/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "assert.h"
+#include "numa.h"
+
+#define NUMA_MAX_NODES 64
+
+/* From <numaif.h>, which only comes with libnuma */
+#define MPOL_BIND_ 2
+#define MPOL_INTERLEAVE_ 3
+#define MPOL_MF_MOVE_ (1 << 1)
+
+static int nnodes = 1;
+static bool simulated = false;
+static cpu_set_t node_cpus[NUMA_MAX_NODES];
+
+static bool read_cpulist(int node, cpu_set_t *set);
+
+/**********Numa_init********
+ * Finds the nodes of the machine, or makes up simulated ones
+ * Inputs: int simulated_nodes: 0 for the real topology, else the number
+ *         of groups to split the allowed CPUs into
+ * Return: number of nodes
+ * Expects: simulated_nodes between 0 and 64
+ ************************/
+int Numa_init(int simulated_nodes)
+{
+        assert(simulated_nodes >= 0 && simulated_nodes <= NUMA_MAX_NODES);
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+
+        if (simulated_nodes > 0) {
+                simulated = true;
+                nnodes = simulated_nodes;
+                int ncpus = CPU_COUNT(&allowed);
+                int seen = 0;
+                for (int n = 0; n < nnodes; n++) {
+                        CPU_ZERO(&node_cpus[n]);
+                }
+                /* Contiguous groups of the allowed CPUs, like sockets */
+                for (int cpu = 0; cpu < CPU_SETSIZE && seen < ncpus; cpu++) {
+                        if (CPU_ISSET(cpu, &allowed)) {
+                                CPU_SET(cpu, &node_cpus[seen * nnodes
+                                                        / ncpus]);
+                                seen++;
+                        }
+                }
+                /* Fewer CPUs than nodes: the spare nodes share them */
+                for (int n = 0; n < nnodes; n++) {
+                        if (CPU_COUNT(&node_cpus[n]) == 0) {
+                                node_cpus[n] = allowed;
+                        }
+                }
+                return nnodes;
+        }
+
+        simulated = false;
+        nnodes = 0;
+        while (nnodes < NUMA_MAX_NODES &&
+               read_cpulist(nnodes, &node_cpus[nnodes])) {
+                CPU_AND(&node_cpus[nnodes], &node_cpus[nnodes], &allowed);
+                nnodes++;
+        }
+        if (nnodes == 0) {
+                nnodes = 1;
+                node_cpus[0] = allowed;
+        }
+        return nnodes;
+}
+
+int Numa_nodes(void)
+{
+        return nnodes;
+}
+
+bool Numa_simulated(void)
+{
+        return simulated;
+}
+
+/**********Numa_node_of********
+ * Returns the node a worker thread belongs to, so consecutive threads
+ * (and the consecutive item ranges they own) share a node
+ ************************/
+int Numa_node_of(int thread, int nthreads)
+{
+        assert(thread >= 0 && thread < nthreads);
+        return (long) thread * nnodes / nthreads;
+}
+
+/**********Numa_pin********
+ * Restricts the calling thread to the CPUs of one node
+ * Inputs: int node: a node number below Numa_nodes()
+ ************************/
+void Numa_pin(int node)
+{
+        assert(node >= 0 && node < nnodes);
+        if (CPU_COUNT(&node_cpus[node]) > 0) {
+                pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                                       &node_cpus[node]);
+        }
+}
+
+/**********Numa_place********
+ * Binds the pages of a range to one node, or interleaves them over all
+ * nodes, moving pages that are already there
+ * Inputs:
+ *              void *mem, size_t bytes: the range; only whole pages
+ *                                       inside it are affected
+ *              int node: target node for NUMA_BIND
+ *              int policy: one of the NUMA_ policies
+ * Notes: first touch needs no system call, and simulated nodes share
+ *        one real node, so both leave the pages alone
+ ************************/
+void Numa_place(void *mem, size_t bytes, int node, int policy)
+{
+        if (policy == NUMA_FIRST_TOUCH || simulated || nnodes < 2) {
+                return;
+        }
+        long page = sysconf(_SC_PAGESIZE);
+        uintptr_t start = ((uintptr_t) mem + page - 1) & ~(uintptr_t)
+                          (page - 1);
+        uintptr_t end = ((uintptr_t) mem + bytes) & ~(uintptr_t) (page - 1);
+        if (end <= start) {
+                return;
+        }
+
+        unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+        memset(mask, 0, sizeof(mask));
+        int mode;
+        if (policy == NUMA_BIND) {
+                mask[node / (8 * sizeof(long))] |= 1UL << (node % (8 *
+                                                          sizeof(long)));
+                mode = MPOL_BIND_;
+        } else {
+                for (int n = 0; n < nnodes; n++) {
+                        mask[n / (8 * sizeof(long))] |= 1UL << (n % (8 *
+                                                          sizeof(long)));
+                }
+                mode = MPOL_INTERLEAVE_;
+        }
+        /* Placement is a hint: failure only costs locality */
+        syscall(SYS_mbind, (void *) start, end - start, mode, mask,
+                NUMA_MAX_NODES, MPOL_MF_MOVE_);
+}
+
+/**********Numa_counts********
+ * Sums the local_node and other_node counters of every node's numastat
+ * Inputs: struct Numa_counts *counts: filled in
+ * Return: false if no node exposes the counters
+ ************************/
+bool Numa_counts(struct Numa_counts *counts)
+{
+        assert(counts != NULL);
+        counts->local = counts->remote = 0;
+        bool found = false;
+
+        for (int n = 0; n < NUMA_MAX_NODES; n++) {
+                char path[64];
+                snprintf(path, sizeof(path),
+                         "/sys/devices/system/node/node%d/numastat", n);
+                FILE *fp = fopen(path, "r");
+                if (fp == NULL) {
+                        break;
+                }
+                char key[32];
+                unsigned long long value;
+                while (fscanf(fp, "%31s %llu", key, &value) == 2) {
+                        if (strcmp(key, "local_node") == 0) {
+                                counts->local += value;
+                                found = true;
+                        } else if (strcmp(key, "other_node") == 0) {
+                                counts->remote += value;
+                        }
+                }
+                fclose(fp);
+        }
+        return found;
+}
+
+/**********read_cpulist********
+ * Parses /sys/devices/system/node/node<node>/cpulist ("0-3,8-11")
+ * Return: false if the node does not exist
+ ************************/
+static bool read_cpulist(int node, cpu_set_t *set)
+{
+        char path[64];
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+                return false;
+        }
+        CPU_ZERO(set);
+        int lo, hi;
+        char sep;
+        while (fscanf(fp, "%d", &lo) == 1) {
+                hi = lo;
+                sep = getc(fp);
+                if (sep == '-') {
+                        if (fscanf(fp, "%d", &hi) != 1) {
+                                break;
+                        }
+                        sep = getc(fp);
+                }
+                for (int cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++) {
+                        CPU_SET(cpu, set);
+                }
+                if (sep != ',') {
+                        break;
+                }
+        }
+        fclose(fp);
+        return true;
+}
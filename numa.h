@@ -0,0 +1,51 @@
+/**************************************************************
+ *                     numa.h
+ *
+ *     interface for NUMA placement: the machine's nodes (or nodes
+ *     simulated by splitting the allowed CPUs into groups), pinning
+ *     threads to a node, binding or interleaving memory, and the
+ *     kernel's per-node allocation counters
+ *
+ **************************************************************/
+#ifndef NUMA_INCLUDED
+#define NUMA_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Where rasters used by parallel rotation are placed */
+enum {
+        NUMA_FIRST_TOUCH = 0,   /* pages land where a pinned worker
+                                   first writes them */
+        NUMA_INTERLEAVE,        /* pages spread round robin over nodes */
+        NUMA_BIND               /* pages bound to the node of the thread
+                                   that owns them */
+};
+
+/* simulated_nodes > 0 splits the allowed CPUs into that many fake
+ * nodes; memory policies then do nothing. Returns the node count.
+ */
+extern int  Numa_init(int simulated_nodes);
+extern int  Numa_nodes(void);
+extern bool Numa_simulated(void);
+
+/* Node that thread (of nthreads) works on; threads are spread evenly */
+extern int  Numa_node_of(int thread, int nthreads);
+
+/* Restricts the calling thread to the CPUs of node */
+extern void Numa_pin(int node);
+
+/* Applies policy to the pages wholly inside [mem, mem + bytes) */
+extern void Numa_place(void *mem, size_t bytes, int node, int policy);
+
+/* Pages allocated on the intended node and elsewhere, summed over all
+ * nodes from /sys; these are system-wide counters, not this process's.
+ * False when the kernel does not expose them
+ */
+struct Numa_counts {
+        unsigned long long local;
+        unsigned long long remote;
+};
+extern bool Numa_counts(struct Numa_counts *counts);
+
+#endif
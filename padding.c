@@ -0,0 +1,80 @@
+/**************************************************************
+ *                     padding.c
+ *
+ *     implementation of the anti-aliasing padding heuristic. An L1 of
+ *     32KB and 8 ways maps each 4KB span of memory onto all of its
+ *     sets, so a stride within a line of a multiple of 512 bytes
+ *     revisits the same handful of sets every 8 rows or fewer. Such
+ *     strides are bumped past the next line.
+ *
+ **************************************************************/
+#include <stdbool.h>
+
+#include "assert.h"
+#include "padding.h"
+
+#define LINE 64                 /* bytes in a cache line */
+#define SET_SPAN 4096           /* bytes covering every L1 set once */
+
+static int policy = PADDING_AUTO;
+
+static bool aliases(long stride);
+
+void Padding_set(int new_policy)
+{
+        assert(new_policy == PADDING_AUTO || new_policy == PADDING_NONE);
+        policy = new_policy;
+}
+
+int Padding_policy(void)
+{
+        return policy;
+}
+
+/**********Padding_pitch********
+ * Row pitch in cells: cells itself, or the fewest more cells that take
+ * the stride out of aliasing range
+ * Inputs:
+ *              int cells: cells in a row
+ *              int size: bytes per cell
+ * Return: cells from one row start to the next
+ ************************/
+int Padding_pitch(int cells, int size)
+{
+        assert(cells >= 0 && size > 0);
+        if (policy == PADDING_NONE) {
+                return cells;
+        }
+
+        int pitch = cells;
+        while (aliases((long) pitch * size)) {
+                pitch++;
+        }
+        return pitch;
+}
+
+/**********Padding_stagger********
+ * Shift between neighbouring blocks: a whole line, in cells
+ ************************/
+int Padding_stagger(int size)
+{
+        assert(size > 0);
+        if (policy == PADDING_NONE) {
+                return 0;
+        }
+        return (LINE + size - 1) / size;
+}
+
+/* True when stride lands within a line of a multiple of SET_SPAN / 8;
+ * strides shorter than a line never alias
+ */
+static bool aliases(long stride)
+{
+        long period = SET_SPAN / 8;
+        long r = stride % period;
+
+        if (stride < LINE) {
+                return false;
+        }
+        return r < LINE || r > period - LINE;
+}
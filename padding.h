@@ -0,0 +1,37 @@
+/**************************************************************
+ *                     padding.h
+ *
+ *     interface for the padding that keeps rows and blocks from
+ *     aliasing in the cache. When a row stride is (nearly) a multiple
+ *     of a power of two, walking down a column touches only a few cache
+ *     sets; a few cells of padding per row, and a staggered start for
+ *     each block, spread those walks over all of them.
+ *
+ **************************************************************/
+#ifndef PADDING_INCLUDED
+#define PADDING_INCLUDED
+
+enum {
+        PADDING_AUTO = 0,       /* pad strides that alias (the default) */
+        PADDING_NONE            /* rows and blocks packed end to end */
+};
+
+/* Policy for arrays made from now on; existing arrays keep theirs */
+extern void Padding_set(int policy);
+extern int  Padding_policy(void);
+
+/* Cells from the start of one row to the next, for rows of cells
+ * cells of size bytes; at least cells
+ */
+extern int  Padding_pitch(int cells, int size);
+
+/* Cells between the starts of neighbouring blocks' storage, so that
+ * the same cell of neighbouring blocks falls in different sets; 0 when
+ * nothing is staggered
+ */
+extern int  Padding_stagger(int size);
+
+/* Number of distinct stagger offsets a layout cycles through */
+#define PADDING_SLOTS 8
+
+#endif
@@ -0,0 +1,101 @@
+/**************************************************************
+ *                     parallel.c
+ *
+ *     implementation of the parallel range splitter
+ *
+ **************************************************************/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "parallel.h"
+#include "numa.h"
+#include "trace.h"
+
+struct slice {
+        pthread_t thread;
+        int index, nthreads;
+        int first, last;
+        Parallel_work *work;
+        void *cl;
+};
+
+static void *slice_main(void *vslice);
+
+/**********Parallel_run********
+ * Splits items [0, nitems) into nthreads contiguous slices and runs work
+ * on each in its own thread
+ * Inputs:
+ *              int nthreads: number of threads
+ *              int nitems: number of items
+ *              Parallel_work *work: called once per thread
+ *              void *cl: passed through to work
+ * Return: N/A, once every thread has finished
+ * Expects: nthreads positive, nitems non negative
+ ************************/
+void Parallel_run(int nthreads, int nitems, Parallel_work *work, void *cl)
+{
+        assert(nthreads > 0 && nitems >= 0 && work != NULL);
+        struct slice *slices = malloc(nthreads * sizeof(*slices));
+        assert(slices != NULL);
+
+        for (int t = 0; t < nthreads; t++) {
+                slices[t].index = t;
+                slices[t].nthreads = nthreads;
+                slices[t].first = (long) nitems * t / nthreads;
+                slices[t].last = (long) nitems * (t + 1) / nthreads;
+                slices[t].work = work;
+                slices[t].cl = cl;
+                int rc = pthread_create(&slices[t].thread, NULL, slice_main,
+                                        &slices[t]);
+                assert(rc == 0);
+        }
+        for (int t = 0; t < nthreads; t++) {
+                pthread_join(slices[t].thread, NULL);
+        }
+        free(slices);
+}
+
+/**********Parallel_nthreads********
+ * Returns the number of processors online, between 1 and
+ * PARALLEL_MAX_THREADS
+ ************************/
+int Parallel_nthreads(void)
+{
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        if (online < 1) {
+                return 1;
+        }
+        return online < PARALLEL_MAX_THREADS ? online : PARALLEL_MAX_THREADS;
+}
+
+/**********Parallel_nthreads_for********
+ * Returns how many threads are worth starting for work units of work:
+ * as many as Parallel_nthreads allows, but no more than give each
+ * thread PARALLEL_GRAIN units, so small jobs run on the caller alone
+ * Inputs: long work: units of work, e.g. cells to visit
+ * Return: between 1 and Parallel_nthreads()
+ ************************/
+int Parallel_nthreads_for(long work)
+{
+        long worth = work / PARALLEL_GRAIN;
+        if (worth < 1) {
+                return 1;
+        }
+        int nthreads = Parallel_nthreads();
+        return worth < nthreads ? worth : nthreads;
+}
+
+static void *slice_main(void *vslice)
+{
+        struct slice *slice = vslice;
+        if (Numa_nodes() > 1) {
+                Numa_pin(Numa_node_of(slice->index, slice->nthreads));
+        }
+        Trace_begin("worker");
+        slice->work(slice->index, slice->first, slice->last, slice->cl);
+        Trace_end();
+        return NULL;
+}
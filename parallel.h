@@ -0,0 +1,33 @@
+/**************************************************************
+ *                     parallel.h
+ *
+ *     interface for splitting a range of items over threads. Thread t
+ *     always gets the t-th contiguous slice, and when there is more
+ *     than one NUMA node it is pinned to Numa_node_of(t), so memory a
+ *     thread first touches stays on the node that later works on it.
+ *
+ **************************************************************/
+#ifndef PARALLEL_INCLUDED
+#define PARALLEL_INCLUDED
+
+typedef void Parallel_work(int thread, int first, int last, void *cl);
+
+/* Calls work(t, first, last, cl) for items [first, last) on nthreads
+ * threads and waits for all of them
+ */
+extern void Parallel_run(int nthreads, int nitems, Parallel_work *work,
+                         void *cl);
+
+/* Number of threads to use when the caller has no better idea: the
+ * processors online, at most PARALLEL_MAX_THREADS
+ */
+#define PARALLEL_MAX_THREADS 64
+extern int  Parallel_nthreads(void);
+
+/* Threads worth starting for work units of work: each gets at least
+ * PARALLEL_GRAIN units, so below that the caller works alone
+ */
+#define PARALLEL_GRAIN (1L << 16)
+extern int  Parallel_nthreads_for(long work);
+
+#endif
@@ -0,0 +1,105 @@
+/**************************************************************
+ *                     perfcount.c
+ *
+ *     implementation of the hardware event counters. Each thread has its
+ *     own counters, opened on its first Perf_start, which count only
+ *     that thread's user-space events.
+ *
+ **************************************************************/
+
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "perfcount.h"
+
+#define NEVENTS 3
+
+/* Per thread, since a counter follows the thread that opened it */
+static __thread int fds[NEVENTS] = { -1, -1, -1 };
+static __thread bool opened = false;
+
+static int open_event(unsigned type, unsigned long long config);
+
+/**********Perf_start********
+ * Zeroes and starts every counter that could be opened
+ ************************/
+void Perf_start(void)
+{
+        if (!opened) {
+                fds[0] = open_event(PERF_TYPE_HARDWARE,
+                                    PERF_COUNT_HW_CPU_CYCLES);
+                fds[1] = open_event(PERF_TYPE_HW_CACHE,
+                                    PERF_COUNT_HW_CACHE_L1D |
+                                    PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                    PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                fds[2] = open_event(PERF_TYPE_HARDWARE,
+                                    PERF_COUNT_HW_CACHE_MISSES);
+                opened = true;
+        }
+        for (int i = 0; i < NEVENTS; i++) {
+                if (fds[i] >= 0) {
+                        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+                        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+                }
+        }
+}
+
+/**********Perf_stop********
+ * Stops every counter, keeping its count for Perf_read
+ ************************/
+void Perf_stop(void)
+{
+        for (int i = 0; i < NEVENTS; i++) {
+                if (fds[i] >= 0) {
+                        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+                }
+        }
+}
+
+/**********Perf_read********
+ * Reads the counts of the last Perf_start to Perf_stop interval
+ * Inputs: struct Perf_counts *counts: filled in, -1 for missing counters
+ * Return: false if none of the counters could be opened
+ ************************/
+bool Perf_read(struct Perf_counts *counts)
+{
+        assert(counts != NULL);
+        long long values[NEVENTS];
+        bool any = false;
+
+        for (int i = 0; i < NEVENTS; i++) {
+                values[i] = -1;
+                if (fds[i] >= 0 &&
+                    read(fds[i], &values[i], sizeof(values[i])) ==
+                    sizeof(values[i])) {
+                        any = true;
+                } else {
+                        values[i] = -1;
+                }
+        }
+        counts->cycles = values[0];
+        counts->l1d_misses = values[1];
+        counts->llc_misses = values[2];
+        return any;
+}
+
+/**********open_event********
+ * Opens one disabled user-space counter for the calling thread
+ * Return: its file descriptor, or -1 if the event cannot be counted
+ ************************/
+static int open_event(unsigned type, unsigned long long config)
+{
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
@@ -0,0 +1,28 @@
+/**************************************************************
+ *                     perfcount.h
+ *
+ *     interface for the hardware event counters of the calling thread,
+ *     read through perf_event_open. Machines or containers that do not
+ *     allow counting simply report no counts.
+ *
+ **************************************************************/
+#ifndef PERFCOUNT_INCLUDED
+#define PERFCOUNT_INCLUDED
+
+#include <stdbool.h>
+
+/* Events counted between Perf_start and Perf_stop, -1 if not counted */
+struct Perf_counts {
+        long long cycles;
+        long long l1d_misses;   /* L1 data cache read misses */
+        long long llc_misses;   /* last level cache misses */
+};
+
+/* Count the calling thread only; each thread starts and reads its own */
+extern void Perf_start(void);
+extern void Perf_stop(void);
+
+/* false if no counter could be opened */
+extern bool Perf_read(struct Perf_counts *counts);
+
+#endif
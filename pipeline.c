@@ -0,0 +1,484 @@
+/**************************************************************
+ *                     pipeline.c
+ *
+ *     implementation of the pipelined rotation. The source raster is
+ *     never built: workers decode each input strip straight into its
+ *     rotated place in the destination. An output strip may be encoded
+ *     once every input strip it draws from is done; at angle 0 that is
+ *     one strip, so the whole run streams, while 90 and 270 need every
+ *     input strip and only overlap reading with rotating.
+ *
+ **************************************************************/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "assert.h"
+#include "pipeline.h"
+#include "trace.h"
+#include "dihedral.h"
+#include "pnm.h"
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+/* Bytes of input aimed for in one strip */
+#define STRIP_BYTES (256 * 1024)
+
+/* States of an output strip */
+enum { OUT_PENDING = 0, OUT_ENCODING, OUT_ENCODED };
+
+struct pipeline {
+        FILE *in, *out;
+        A2Methods_T methods;
+        A2 raster;              /* destination */
+        Dihedral_T op;
+        int width, height;      /* of the source */
+        int out_width, out_height;
+        int maxval, sample_bytes;
+        int strip_rows;
+        int nstrips_in, nstrips_out;
+
+        pthread_mutex_t lock;
+        pthread_cond_t changed;
+        bool failed;
+
+        /* Input buffers cycle reader -> ready queue -> worker -> free */
+        int nbufs;
+        unsigned char **bufs;
+        int *free_bufs, nfree;
+        int *ready_strip, *ready_buf, ready_head, ready_len;
+        bool *in_done;
+
+        /* Output strips are encoded in order, at most nbufs ahead */
+        int *out_state;
+        unsigned char **out_bytes;
+        size_t *out_len;
+        int next_encode, next_write;
+
+        struct Pipeline_stats *stats;
+};
+
+static int read_number(FILE *in);
+static void *reader_main(void *vp);
+static void *worker_main(void *vp);
+static void *writer_main(void *vp);
+static bool out_ready(struct pipeline *p, int strip);
+static void transform_strip(struct pipeline *p, int strip,
+                            const unsigned char *bytes);
+static size_t encode_strip(struct pipeline *p, int strip,
+                           unsigned char **bytes);
+static void fail(struct pipeline *p);
+static double now_ns(void);
+
+/**********Pipeline_run********
+ * Reads, rotates and writes a binary ppm with the stages overlapped
+ * Inputs:
+ *              FILE *in: a binary (P6) ppm
+ *              FILE *out: where the rotated image is written
+ *              A2Methods_T methods: suite for the destination raster
+ *              int angle: 0, 90, 180 or 270
+ *              int nworkers: number of rotating threads
+ *              struct Pipeline_stats *stats: filled in with stage times,
+ *                      may be NULL
+ * Return: 0 on success, nonzero if in is not a complete P6 image
+ * Expects: methods safe for concurrent access to distinct cells
+ ************************/
+int Pipeline_run(FILE *in, FILE *out, A2Methods_T methods, int angle,
+                 int nworkers, struct Pipeline_stats *stats)
+{
+        assert(in != NULL && out != NULL && methods != NULL);
+        assert(nworkers > 0);
+        struct Pipeline_stats scratch;
+        if (stats == NULL) {
+                stats = &scratch;
+        }
+        memset(stats, 0, sizeof(*stats));
+        double start = now_ns();
+
+        /* Header: "P6" then width, height and maxval */
+        if (getc(in) != 'P' || getc(in) != '6') {
+                return 1;
+        }
+        struct pipeline p;
+        memset(&p, 0, sizeof(p));
+        p.width = read_number(in);
+        p.height = read_number(in);
+        p.maxval = read_number(in);
+        if (p.width <= 0 || p.height <= 0 || p.maxval <= 0 ||
+            p.maxval > 65535) {
+                return 1;
+        }
+        stats->width = p.width;
+        stats->height = p.height;
+
+        p.in = in;
+        p.out = out;
+        p.methods = methods;
+        p.op = Dihedral_from_angle(angle);
+        p.out_width = Dihedral_swaps_dims(p.op) ? p.height : p.width;
+        p.out_height = Dihedral_swaps_dims(p.op) ? p.width : p.height;
+        p.sample_bytes = p.maxval < 256 ? 1 : 2;
+        size_t row_bytes = (size_t) p.width * 3 * p.sample_bytes;
+        p.strip_rows = STRIP_BYTES / row_bytes;
+        if (p.strip_rows < 1) {
+                p.strip_rows = 1;
+        }
+        p.nstrips_in = (p.height + p.strip_rows - 1) / p.strip_rows;
+        p.nstrips_out = (p.out_height + p.strip_rows - 1) / p.strip_rows;
+        p.raster = methods->new(p.out_width, p.out_height,
+                                sizeof(struct Pnm_rgb));
+        p.stats = stats;
+
+        /* Every worker can hold a strip while the reader fills another */
+        p.nbufs = nworkers + 2;
+        p.bufs = malloc(p.nbufs * sizeof(*p.bufs));
+        p.free_bufs = malloc(p.nbufs * sizeof(int));
+        p.ready_strip = malloc(p.nbufs * sizeof(int));
+        p.ready_buf = malloc(p.nbufs * sizeof(int));
+        p.in_done = calloc(p.nstrips_in, sizeof(bool));
+        p.out_state = calloc(p.nstrips_out, sizeof(int));
+        p.out_bytes = calloc(p.nstrips_out, sizeof(*p.out_bytes));
+        p.out_len = calloc(p.nstrips_out, sizeof(size_t));
+        assert(p.bufs && p.free_bufs && p.ready_strip && p.ready_buf);
+        assert(p.in_done && p.out_state && p.out_bytes && p.out_len);
+        for (int i = 0; i < p.nbufs; i++) {
+                p.bufs[i] = malloc(row_bytes * p.strip_rows);
+                assert(p.bufs[i] != NULL);
+                p.free_bufs[i] = i;
+        }
+        p.nfree = p.nbufs;
+        pthread_mutex_init(&p.lock, NULL);
+        pthread_cond_init(&p.changed, NULL);
+
+        pthread_t reader, writer;
+        pthread_t *workers = malloc(nworkers * sizeof(pthread_t));
+        assert(workers != NULL);
+        pthread_create(&reader, NULL, reader_main, &p);
+        pthread_create(&writer, NULL, writer_main, &p);
+        for (int i = 0; i < nworkers; i++) {
+                pthread_create(&workers[i], NULL, worker_main, &p);
+        }
+        pthread_join(reader, NULL);
+        for (int i = 0; i < nworkers; i++) {
+                pthread_join(workers[i], NULL);
+        }
+        pthread_join(writer, NULL);
+
+        for (int i = 0; i < p.nbufs; i++) {
+                free(p.bufs[i]);
+        }
+        for (int j = 0; j < p.nstrips_out; j++) {
+                free(p.out_bytes[j]);
+        }
+        free(workers);
+        free(p.bufs);
+        free(p.free_bufs);
+        free(p.ready_strip);
+        free(p.ready_buf);
+        free(p.in_done);
+        free(p.out_state);
+        free(p.out_bytes);
+        free(p.out_len);
+        pthread_mutex_destroy(&p.lock);
+        pthread_cond_destroy(&p.changed);
+        methods->free(&p.raster);
+
+        stats->wall = now_ns() - start;
+        return p.failed ? 1 : 0;
+}
+
+/**********read_number********
+ * Reads one header number, skipping whitespace and # comments; the
+ * single whitespace character after the number is consumed too
+ * Return: the number, or -1 on malformed input
+ ************************/
+static int read_number(FILE *in)
+{
+        int c = getc(in);
+        while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(in);
+                        }
+                }
+                c = getc(in);
+        }
+        if (c < '0' || c > '9') {
+                return -1;
+        }
+        long n = 0;
+        while (c >= '0' && c <= '9') {
+                n = n * 10 + (c - '0');
+                if (n > 1 << 30) {
+                        return -1;
+                }
+                c = getc(in);
+        }
+        return n;
+}
+
+/**********reader_main********
+ * Reader thread: fills free buffers with consecutive input strips
+ ************************/
+static void *reader_main(void *vp)
+{
+        struct pipeline *p = vp;
+        size_t row_bytes = (size_t) p->width * 3 * p->sample_bytes;
+
+        for (int k = 0; k < p->nstrips_in; k++) {
+                pthread_mutex_lock(&p->lock);
+                while (p->nfree == 0 && !p->failed) {
+                        pthread_cond_wait(&p->changed, &p->lock);
+                }
+                if (p->failed) {
+                        pthread_mutex_unlock(&p->lock);
+                        break;
+                }
+                int buf = p->free_bufs[--(p->nfree)];
+                pthread_mutex_unlock(&p->lock);
+
+                int rows = p->height - k * p->strip_rows;
+                rows = rows < p->strip_rows ? rows : p->strip_rows;
+                size_t want = row_bytes * rows;
+                double start = now_ns();
+                Trace_begin("read");
+                size_t got = fread(p->bufs[buf], 1, want, p->in);
+                Trace_end();
+                p->stats->read += now_ns() - start;
+                if (got != want) {
+                        fail(p);
+                        break;
+                }
+
+                pthread_mutex_lock(&p->lock);
+                int slot = (p->ready_head + p->ready_len) % p->nbufs;
+                p->ready_strip[slot] = k;
+                p->ready_buf[slot] = buf;
+                p->ready_len++;
+                pthread_cond_broadcast(&p->changed);
+                pthread_mutex_unlock(&p->lock);
+        }
+        return NULL;
+}
+
+/**********worker_main********
+ * Worker thread: encodes the next output strip when it is ready and the
+ * writer is not too far behind, otherwise rotates a ready input strip
+ ************************/
+static void *worker_main(void *vp)
+{
+        struct pipeline *p = vp;
+        double busy = 0.0;
+
+        pthread_mutex_lock(&p->lock);
+        while (!p->failed) {
+                int j = p->next_encode;
+                if (j < p->nstrips_out && j < p->next_write + p->nbufs &&
+                    out_ready(p, j)) {
+                        p->next_encode++;
+                        p->out_state[j] = OUT_ENCODING;
+                        pthread_mutex_unlock(&p->lock);
+
+                        double start = now_ns();
+                        unsigned char *bytes;
+                        Trace_begin("encode");
+                        size_t len = encode_strip(p, j, &bytes);
+                        Trace_end();
+                        busy += now_ns() - start;
+
+                        pthread_mutex_lock(&p->lock);
+                        p->out_bytes[j] = bytes;
+                        p->out_len[j] = len;
+                        p->out_state[j] = OUT_ENCODED;
+                        pthread_cond_broadcast(&p->changed);
+                        continue;
+                }
+                if (p->ready_len > 0) {
+                        int k = p->ready_strip[p->ready_head];
+                        int buf = p->ready_buf[p->ready_head];
+                        p->ready_head = (p->ready_head + 1) % p->nbufs;
+                        p->ready_len--;
+                        pthread_mutex_unlock(&p->lock);
+
+                        double start = now_ns();
+                        Trace_begin("transform");
+                        transform_strip(p, k, p->bufs[buf]);
+                        Trace_end();
+                        busy += now_ns() - start;
+
+                        pthread_mutex_lock(&p->lock);
+                        p->in_done[k] = true;
+                        p->free_bufs[(p->nfree)++] = buf;
+                        pthread_cond_broadcast(&p->changed);
+                        continue;
+                }
+                if (p->next_encode == p->nstrips_out) {
+                        break;          /* nothing left for workers */
+                }
+                pthread_cond_wait(&p->changed, &p->lock);
+        }
+        p->stats->transform += busy;
+        pthread_mutex_unlock(&p->lock);
+        return NULL;
+}
+
+/**********writer_main********
+ * Writer thread: emits each output strip in order, preceded by the
+ * header once the first strip is ready, so input that is cut short
+ * before any strip can be written leaves out untouched
+ ************************/
+static void *writer_main(void *vp)
+{
+        struct pipeline *p = vp;
+
+        for (int j = 0; j < p->nstrips_out; j++) {
+                pthread_mutex_lock(&p->lock);
+                while (p->out_state[j] != OUT_ENCODED && !p->failed) {
+                        pthread_cond_wait(&p->changed, &p->lock);
+                }
+                if (p->failed) {
+                        pthread_mutex_unlock(&p->lock);
+                        break;
+                }
+                pthread_mutex_unlock(&p->lock);
+
+                double start = now_ns();
+                Trace_begin("write");
+                if (j == 0) {
+                        fprintf(p->out, "P6\n%d %d\n%d\n", p->out_width,
+                                p->out_height, p->maxval);
+                }
+                fwrite(p->out_bytes[j], 1, p->out_len[j], p->out);
+                Trace_end();
+                p->stats->write += now_ns() - start;
+
+                pthread_mutex_lock(&p->lock);
+                free(p->out_bytes[j]);
+                p->out_bytes[j] = NULL;
+                p->next_write++;
+                pthread_cond_broadcast(&p->changed);
+                pthread_mutex_unlock(&p->lock);
+        }
+        double start = now_ns();
+        fflush(p->out);
+        p->stats->write += now_ns() - start;
+        return NULL;
+}
+
+/**********out_ready********
+ * Tells whether every input strip an output strip draws from is done
+ * Expects: the lock is held
+ ************************/
+static bool out_ready(struct pipeline *p, int strip)
+{
+        int col = 0, row = strip * p->strip_rows;
+        int w = p->out_width;
+        int h = p->out_height - row;
+        h = h < p->strip_rows ? h : p->strip_rows;
+
+        /* Source rows under this strip of the destination */
+        Dihedral_rect(Dihedral_inverse(p->op), p->out_width, p->out_height,
+                      &col, &row, &w, &h);
+        for (int k = row / p->strip_rows; k <= (row + h - 1) / p->strip_rows;
+             k++) {
+                if (!p->in_done[k]) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+/**********transform_strip********
+ * Decodes one input strip straight into its rotated place
+ ************************/
+static void transform_strip(struct pipeline *p, int strip,
+                            const unsigned char *bytes)
+{
+        int row0 = strip * p->strip_rows;
+        int rows = p->height - row0;
+        rows = rows < p->strip_rows ? rows : p->strip_rows;
+        int wide = p->sample_bytes == 2;
+
+        for (int r = row0; r < row0 + rows; r++) {
+                for (int c = 0; c < p->width; c++) {
+                        struct Pnm_rgb pixel;
+                        if (wide) {
+                                pixel.red = bytes[0] << 8 | bytes[1];
+                                pixel.green = bytes[2] << 8 | bytes[3];
+                                pixel.blue = bytes[4] << 8 | bytes[5];
+                        } else {
+                                pixel.red = bytes[0];
+                                pixel.green = bytes[1];
+                                pixel.blue = bytes[2];
+                        }
+                        bytes += 3 * p->sample_bytes;
+
+                        int dcol, drow;
+                        Dihedral_point(p->op, p->width, p->height, c, r,
+                                       &dcol, &drow);
+                        *(Pnm_rgb) p->methods->at(p->raster, dcol, drow) =
+                                pixel;
+                }
+        }
+}
+
+/**********encode_strip********
+ * Encodes one strip of the destination as P6 raster bytes
+ * Inputs: the pipeline, the output strip, and where to put the malloc'd
+ *         bytes
+ * Return: number of bytes
+ ************************/
+static size_t encode_strip(struct pipeline *p, int strip,
+                           unsigned char **bytes)
+{
+        int row0 = strip * p->strip_rows;
+        int rows = p->out_height - row0;
+        rows = rows < p->strip_rows ? rows : p->strip_rows;
+        size_t len = (size_t) rows * p->out_width * 3 * p->sample_bytes;
+        unsigned char *out = malloc(len);
+        assert(out != NULL);
+        *bytes = out;
+        int wide = p->sample_bytes == 2;
+
+        for (int r = row0; r < row0 + rows; r++) {
+                for (int c = 0; c < p->out_width; c++) {
+                        Pnm_rgb pixel = p->methods->at(p->raster, c, r);
+                        if (wide) {
+                                out[0] = pixel->red >> 8;
+                                out[1] = pixel->red;
+                                out[2] = pixel->green >> 8;
+                                out[3] = pixel->green;
+                                out[4] = pixel->blue >> 8;
+                                out[5] = pixel->blue;
+                                out += 6;
+                        } else {
+                                out[0] = pixel->red;
+                                out[1] = pixel->green;
+                                out[2] = pixel->blue;
+                                out += 3;
+                        }
+                }
+        }
+        return len;
+}
+
+/**********fail********
+ * Marks the run as failed and wakes every thread so they can stop
+ ************************/
+static void fail(struct pipeline *p)
+{
+        pthread_mutex_lock(&p->lock);
+        p->failed = true;
+        pthread_cond_broadcast(&p->changed);
+        pthread_mutex_unlock(&p->lock);
+}
+
+static double now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
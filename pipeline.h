@@ -0,0 +1,34 @@
+/**************************************************************
+ *                     pipeline.h
+ *
+ *     interface for the pipelined rotation: a reader thread decodes
+ *     strips of rows, worker threads rotate them into the destination
+ *     raster and encode finished output strips, and a writer thread
+ *     emits those strips in order, so reading, computing and writing
+ *     overlap instead of running back to back
+ *
+ **************************************************************/
+#ifndef PIPELINE_INCLUDED
+#define PIPELINE_INCLUDED
+
+#include <stdio.h>
+#include "a2methods.h"
+
+/* Wall time and the time each stage spent busy, in nanoseconds */
+struct Pipeline_stats {
+        double wall;
+        double read;            /* reader waiting on input */
+        double transform;       /* all workers, rotating and encoding */
+        double write;           /* writer waiting on output */
+        int width, height;      /* of the input image */
+};
+
+/* Rotates the binary (P6) image on in by angle and writes it to out.
+ * methods makes the destination raster and must be safe for different
+ * threads touching different cells at once (plain and blocked are;
+ * compressed is not). Returns 0 on success, nonzero for bad input.
+ */
+extern int Pipeline_run(FILE *in, FILE *out, A2Methods_T methods, int angle,
+                        int nworkers, struct Pipeline_stats *stats);
+
+#endif
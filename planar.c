@@ -0,0 +1,371 @@
+/**************************************************************
+ *                     planar.c
+ *
+ *     implementation of planar images. The storage is padded: plain
+ *     rows to a whole number of cache lines and blocked planes to a
+ *     whole number of blocks. The image is a width x height window at
+ *     (col0, row0) of the storage, so a blocked image can be rotated by
+ *     turning whole blocks of the padded storage and moving the window.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "planar.h"
+#include "dihedral.h"
+#include "pnm.h"
+
+#define T Planar_T
+
+/* Planes start on, and plain rows are padded to, whole cache lines */
+#define LINE_BYTES 64
+#define LINE_SAMPLES (LINE_BYTES / (int) sizeof(uint16_t))
+
+/* Side of the tiles plain planes are rotated in */
+#define TILE 32
+
+struct T {
+        int width, height;      /* the image */
+        int col0, row0;         /* where the image starts in storage */
+        int pwidth, pheight;    /* the padded storage */
+        int pitch;              /* samples per storage row (plain) */
+        int blocksize;          /* 1 for plain planes */
+        uint16_t *planes[3];
+};
+
+static T planar_alloc(int width, int height, int blocksize, int pwidth,
+                      int pheight);
+static size_t planar_offset(T planar, int col, int row);
+static void deinterleave_cell(int col, int row, A2Methods_UArray2 array2,
+                              void *elem, void *cl);
+static void rotate_tile(int angle, const uint16_t *restrict src, int spitch,
+                        uint16_t *restrict dst, int dpitch, int w, int h);
+
+/**********Planar_new********
+ * Creates a planar image with every sample zero
+ * Inputs:
+ *              int width, height: dimensions of the image
+ *              int blocksize: side of the square blocks, 1 for plain planes
+ * Return: the new image
+ * Expects: positive arguments, else a checked runtime error
+ ************************/
+T Planar_new(int width, int height, int blocksize)
+{
+        assert(width > 0 && height > 0 && blocksize > 0);
+        int pwidth = (width + blocksize - 1) / blocksize * blocksize;
+        int pheight = (height + blocksize - 1) / blocksize * blocksize;
+        return planar_alloc(width, height, blocksize, pwidth, pheight);
+}
+
+/**********Planar_free********
+ * Frees the planes and the image, and sets *planar to NULL
+ ************************/
+void Planar_free(T *planar)
+{
+        assert(planar != NULL && *planar != NULL);
+        for (int p = 0; p < 3; p++) {
+                free((*planar)->planes[p]);
+        }
+        free(*planar);
+        *planar = NULL;
+}
+
+int Planar_width(T planar)
+{
+        assert(planar != NULL);
+        return planar->width;
+}
+
+int Planar_height(T planar)
+{
+        assert(planar != NULL);
+        return planar->height;
+}
+
+int Planar_blocksize(T planar)
+{
+        assert(planar != NULL);
+        return planar->blocksize;
+}
+
+/**********Planar_at********
+ * Returns a pointer to one sample
+ * Inputs: the image, PLANAR_RED, _GREEN or _BLUE, and the cell
+ * Expects: the cell lies in the image, else a checked runtime error
+ ************************/
+uint16_t *Planar_at(T planar, int plane, int col, int row)
+{
+        assert(planar != NULL && plane >= 0 && plane < 3);
+        assert(col >= 0 && col < planar->width);
+        assert(row >= 0 && row < planar->height);
+        return planar->planes[plane] + planar_offset(planar, col, row);
+}
+
+/**********Planar_deinterleave********
+ * Copies every pixel of a raster into the planes
+ * Inputs:
+ *              T planar: the image, the same size as the raster
+ *              A2Methods_T methods: suite that reads the raster
+ *              A2Methods_UArray2 pixels: raster of struct Pnm_rgb
+ ************************/
+void Planar_deinterleave(T planar, A2Methods_T methods,
+                         A2Methods_UArray2 pixels)
+{
+        assert(planar != NULL && methods != NULL && pixels != NULL);
+        assert(methods->width(pixels) == planar->width);
+        assert(methods->height(pixels) == planar->height);
+        assert(methods->size(pixels) == sizeof(struct Pnm_rgb));
+        methods->map_default(pixels, deinterleave_cell, planar);
+}
+
+/**********Planar_rotate********
+ * Rotates every plane of the image clockwise
+ * Inputs: T planar: the image; int angle: 0, 90, 180 or 270
+ * Return: a new image with the same blocksize
+ * Notes: plain planes are turned tile by tile; blocked planes turn each
+ *        padded block into its place and move the image's window, so
+ *        the kernel only ever sees whole blocks
+ ************************/
+T Planar_rotate(T planar, int angle)
+{
+        assert(planar != NULL);
+        Dihedral_T op = Dihedral_from_angle(angle);
+        bool turns = Dihedral_swaps_dims(op);
+        int bs = planar->blocksize;
+
+        if (bs == 1) {
+                T result = Planar_new(turns ? planar->height : planar->width,
+                                      turns ? planar->width : planar->height,
+                                      1);
+                for (int p = 0; p < 3; p++) {
+                        const uint16_t *src = planar->planes[p];
+                        uint16_t *dst = result->planes[p];
+                        for (int r = 0; r < planar->height; r += TILE) {
+                                for (int c = 0; c < planar->width; c += TILE) {
+                                        int col = c, row = r;
+                                        int w = planar->width - c < TILE ?
+                                                planar->width - c : TILE;
+                                        int h = planar->height - r < TILE ?
+                                                planar->height - r : TILE;
+                                        int tw = w, th = h;
+                                        Dihedral_rect(op, planar->width,
+                                                      planar->height, &col,
+                                                      &row, &tw, &th);
+                                        rotate_tile(angle,
+                                                    src + (size_t) r *
+                                                    planar->pitch + c,
+                                                    planar->pitch,
+                                                    dst + (size_t) row *
+                                                    result->pitch + col,
+                                                    result->pitch, w, h);
+                                }
+                        }
+                }
+                return result;
+        }
+
+        T result = planar_alloc(turns ? planar->height : planar->width,
+                                turns ? planar->width : planar->height, bs,
+                                turns ? planar->pheight : planar->pwidth,
+                                turns ? planar->pwidth : planar->pheight);
+        int col = planar->col0, row = planar->row0;
+        int w = planar->width, h = planar->height;
+        Dihedral_rect(op, planar->pwidth, planar->pheight, &col, &row, &w,
+                      &h);
+        result->col0 = col;
+        result->row0 = row;
+
+        int blk_width = planar->pwidth / bs, blk_height = planar->pheight / bs;
+        size_t cells = (size_t) bs * bs;
+        for (int p = 0; p < 3; p++) {
+                for (int br = 0; br < blk_height; br++) {
+                        for (int bc = 0; bc < blk_width; bc++) {
+                                int dbc, dbr;
+                                Dihedral_point(op, blk_width, blk_height, bc,
+                                               br, &dbc, &dbr);
+                                size_t from = (size_t) br * blk_width + bc;
+                                size_t to = (size_t) dbr *
+                                            (result->pwidth / bs) + dbc;
+                                rotate_tile(angle,
+                                            planar->planes[p] + from * cells,
+                                            bs,
+                                            result->planes[p] + to * cells,
+                                            bs, bs, bs);
+                        }
+                }
+        }
+        return result;
+}
+
+/**********Planar_write********
+ * Writes the image as a P6 ppm, one row at a time
+ * Inputs:
+ *              FILE *fp: where the image is written
+ *              T planar: the image
+ *              unsigned denominator: maxval of the image
+ * Notes: samples are one byte each below 256 and two above, big end
+ *        first, as the ppm format requires
+ ************************/
+void Planar_write(FILE *fp, T planar, unsigned denominator)
+{
+        assert(fp != NULL && planar != NULL);
+        assert(denominator > 0 && denominator <= 65535);
+        int wide = denominator > 255;
+        size_t row_bytes = (size_t) planar->width * 3 * (wide ? 2 : 1);
+        unsigned char *line = malloc(row_bytes);
+        assert(line != NULL);
+
+        fprintf(fp, "P6\n%d %d\n%u\n", planar->width, planar->height,
+                denominator);
+        for (int r = 0; r < planar->height; r++) {
+                unsigned char *out = line;
+                int c = 0;
+                /* Runs of a row are contiguous up to a block edge */
+                while (c < planar->width) {
+                        int run = planar->width - c;
+                        if (planar->blocksize > 1) {
+                                int bs = planar->blocksize;
+                                int left = bs - (c + planar->col0) % bs;
+                                run = run < left ? run : left;
+                        }
+                        size_t at = planar_offset(planar, c, r);
+                        const uint16_t *red = planar->planes[PLANAR_RED] + at;
+                        const uint16_t *green =
+                                planar->planes[PLANAR_GREEN] + at;
+                        const uint16_t *blue = planar->planes[PLANAR_BLUE] + at;
+                        for (int i = 0; i < run; i++) {
+                                if (wide) {
+                                        *out++ = red[i] >> 8;
+                                        *out++ = red[i];
+                                        *out++ = green[i] >> 8;
+                                        *out++ = green[i];
+                                        *out++ = blue[i] >> 8;
+                                        *out++ = blue[i];
+                                } else {
+                                        *out++ = red[i];
+                                        *out++ = green[i];
+                                        *out++ = blue[i];
+                                }
+                        }
+                        c += run;
+                }
+                fwrite(line, 1, row_bytes, fp);
+        }
+        free(line);
+}
+
+/**********planar_alloc********
+ * Allocates an image over zeroed storage of the given padded size
+ ************************/
+static T planar_alloc(int width, int height, int blocksize, int pwidth,
+                      int pheight)
+{
+        T planar = malloc(sizeof(*planar));
+        assert(planar != NULL);
+        planar->width = width;
+        planar->height = height;
+        planar->col0 = 0;
+        planar->row0 = 0;
+        planar->pwidth = pwidth;
+        planar->pheight = pheight;
+        planar->blocksize = blocksize;
+        planar->pitch = blocksize == 1 ?
+                (pwidth + LINE_SAMPLES - 1) / LINE_SAMPLES * LINE_SAMPLES :
+                pwidth;
+
+        size_t bytes = (size_t) planar->pitch * pheight * sizeof(uint16_t);
+        bytes = (bytes + LINE_BYTES - 1) / LINE_BYTES * LINE_BYTES;
+        for (int p = 0; p < 3; p++) {
+                void *plane;
+                int failed = posix_memalign(&plane, LINE_BYTES, bytes);
+                assert(!failed);
+                planar->planes[p] = plane;
+                memset(planar->planes[p], 0, bytes);
+        }
+        return planar;
+}
+
+/**********planar_offset********
+ * Index of a cell of the image within each plane
+ ************************/
+static size_t planar_offset(T planar, int col, int row)
+{
+        col += planar->col0;
+        row += planar->row0;
+        int bs = planar->blocksize;
+        if (bs == 1) {
+                return (size_t) row * planar->pitch + col;
+        }
+        size_t block = (size_t) (row / bs) * (planar->pwidth / bs) + col / bs;
+        return block * bs * bs + (row % bs) * bs + col % bs;
+}
+
+/**********deinterleave_cell********
+ * apply function for Planar_deinterleave
+ ************************/
+static void deinterleave_cell(int col, int row, A2Methods_UArray2 array2,
+                              void *elem, void *cl)
+{
+        T planar = cl;
+        Pnm_rgb pixel = elem;
+        size_t at = planar_offset(planar, col, row);
+        (void) array2;
+
+        planar->planes[PLANAR_RED][at] = pixel->red;
+        planar->planes[PLANAR_GREEN][at] = pixel->green;
+        planar->planes[PLANAR_BLUE][at] = pixel->blue;
+}
+
+/**********rotate_tile********
+ * Rotates a w x h tile of one plane clockwise into its place
+ * Inputs:
+ *              int angle: 0, 90, 180 or 270
+ *              src, spitch: top left sample of the tile and its row pitch
+ *              dst, dpitch: top left sample of the rotated tile and its
+ *                           row pitch
+ *              int w, h: dimensions of the source tile
+ * Notes: 0 and 180 are unit-stride copies; 90 and 270 read down source
+ *        columns, which stay in L1 at tile size
+ ************************/
+static void rotate_tile(int angle, const uint16_t *restrict src, int spitch,
+                        uint16_t *restrict dst, int dpitch, int w, int h)
+{
+        switch (angle) {
+        case 0:
+                for (int r = 0; r < h; r++) {
+                        memcpy(dst + (size_t) r * dpitch,
+                               src + (size_t) r * spitch,
+                               w * sizeof(uint16_t));
+                }
+                break;
+        case 180:
+                for (int r = 0; r < h; r++) {
+                        const uint16_t *s = src + (size_t) r * spitch;
+                        uint16_t *d = dst + (size_t) (h - 1 - r) * dpitch;
+                        for (int c = 0; c < w; c++) {
+                                d[w - 1 - c] = s[c];
+                        }
+                }
+                break;
+        case 90:
+                for (int c = 0; c < w; c++) {
+                        uint16_t *d = dst + (size_t) c * dpitch;
+                        for (int r = 0; r < h; r++) {
+                                d[h - 1 - r] = src[(size_t) r * spitch + c];
+                        }
+                }
+                break;
+        case 270:
+                for (int c = 0; c < w; c++) {
+                        uint16_t *d = dst + (size_t) (w - 1 - c) * dpitch;
+                        for (int r = 0; r < h; r++) {
+                                d[r] = src[(size_t) r * spitch + c];
+                        }
+                }
+                break;
+        default:
+                assert(0);
+        }
+}
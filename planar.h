@@ -0,0 +1,48 @@
+/**************************************************************
+ *                     planar.h
+ *
+ *     interface for planar images: the red, green and blue samples of
+ *     a raster kept in three separate, cache-line aligned planes of
+ *     16-bit samples, laid out either row by row or in square blocks.
+ *     Kernels work on one plane at a time over contiguous runs, which
+ *     is the shape compilers vectorize.
+ *
+ **************************************************************/
+#ifndef PLANAR_INCLUDED
+#define PLANAR_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+#include "a2methods.h"
+
+#define T Planar_T
+typedef struct T *T;
+
+/* Planes of the image, in interleaved order */
+#define PLANAR_RED 0
+#define PLANAR_GREEN 1
+#define PLANAR_BLUE 2
+
+/* blocksize 1 lays the planes out row by row */
+extern T    Planar_new(int width, int height, int blocksize);
+extern void Planar_free(T *planar);
+
+extern int  Planar_width(T planar);
+extern int  Planar_height(T planar);
+extern int  Planar_blocksize(T planar);
+extern uint16_t *Planar_at(T planar, int plane, int col, int row);
+
+/* Splits a raster of struct Pnm_rgb into the planes; its samples must
+ * fit in 16 bits
+ */
+extern void Planar_deinterleave(T planar, A2Methods_T methods,
+                                A2Methods_UArray2 pixels);
+
+/* A new planar image holding planar rotated clockwise by angle */
+extern T    Planar_rotate(T planar, int angle);
+
+/* Writes the image as a binary (P6) ppm, interleaving as it goes */
+extern void Planar_write(FILE *fp, T planar, unsigned denominator);
+
+#undef T
+#endif
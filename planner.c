@@ -0,0 +1,342 @@
+/**************************************************************
+ *                     planner.c
+ *
+ *     implementation of the cost-model planner. Every access stream
+ *     costs one line fill per cache line it covers; a stream whose
+ *     reuse distance (the lines it must keep alive to use a line
+ *     fully) does not fit in L1 pays, on every access, the latency of
+ *     the level where it does fit. The constants below are first
+ *     guesses meant to be refit from the CSV that Plan_log writes.
+ *
+ **************************************************************/
+
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "planner.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+
+/* Per-cell cost of at() and the apply call, by layout */
+#define PLAIN_CELL_NS 8.0
+#define BLOCKED_CELL_NS 12.0
+
+/* Cost of starting a block in a block-major map */
+#define BLOCK_NS 100.0
+
+/* Cost of touching a line that is in L2, in the LLC, or in DRAM */
+#define L2_NS 4.0
+#define LLC_NS 12.0
+#define DRAM_NS 60.0
+
+/* Square blocksizes tried for the blocked layout; 0 means the 64KB
+ * default. Rectangles with a side of whole cache lines are tried too,
+ * that side against each of rect_rows.
+ */
+static const int blocksizes[] = { 8, 16, 32, 64, 0 };
+static const int rect_rows[] = { 4, 8, 16 };
+
+static long cache_size(int name, int level, const char *type);
+static double level_ns(const struct Plan_machine *m, double bytes);
+static double stream_ns(const struct Plan_machine *m, double cells,
+                        int size, double reuse_bytes, double fill_ns);
+static double blocked_ns(const struct Plan_machine *m, int width,
+                         int height, int size, bool turns, double fill_ns,
+                         int blk_width, int blk_height);
+
+/**********Plan_machine********
+ * Fills in the cache sizes of the machine
+ * Inputs: struct Plan_machine *machine: filled in
+ * Notes: falls back to 32KB / 1MB / 8MB with 64-byte lines
+ ************************/
+void Plan_machine(struct Plan_machine *machine)
+{
+        assert(machine != NULL);
+        machine->l1 = cache_size(_SC_LEVEL1_DCACHE_SIZE, 1, "Data");
+        machine->l2 = cache_size(_SC_LEVEL2_CACHE_SIZE, 2, "Unified");
+        machine->llc = cache_size(_SC_LEVEL3_CACHE_SIZE, 3, "Unified");
+        machine->line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+
+        if (machine->l1 <= 0) {
+                machine->l1 = 32 * 1024;
+        }
+        if (machine->l2 <= 0) {
+                machine->l2 = 1024 * 1024;
+        }
+        if (machine->llc <= 0) {
+                machine->llc = machine->l2 > 8 * 1024 * 1024 ?
+                               machine->l2 : 8 * 1024 * 1024;
+        }
+        if (machine->line <= 0) {
+                machine->line = 64;
+        }
+}
+
+/**********Plan_choose********
+ * Predicts the cost of every candidate plan and returns the cheapest
+ * Inputs:
+ *              const struct Plan_machine *machine: cache parameters
+ *              int width, height: dimensions of the source
+ *              int size: bytes per element
+ *              int angle: 0, 90, 180 or 270
+ * Return: the chosen plan
+ * Expects: positive dimensions and size
+ ************************/
+struct Plan Plan_choose(const struct Plan_machine *m, int width, int height,
+                        int size, int angle)
+{
+        assert(m != NULL && width > 0 && height > 0 && size > 0);
+        double cells = (double) width * height;
+        bool turns = (angle == 90 || angle == 270);
+
+        /* Lines come from wherever both rasters together fit */
+        double fill_ns = level_ns(m, 2.0 * cells * size);
+
+        /* Row-major: a destination column per source row when turning,
+         * which keeps one line per source column alive */
+        double row_ns = cells * PLAIN_CELL_NS
+                + stream_ns(m, cells, size, 0, fill_ns)
+                + stream_ns(m, cells, size,
+                            turns ? (double) width * m->line : 0, fill_ns);
+
+        /* Column-major: the source walk keeps one line per row alive, and
+         * so does the destination unless the turn makes it a row walk */
+        double col_ns = cells * PLAIN_CELL_NS
+                + stream_ns(m, cells, size, (double) height * m->line,
+                            fill_ns)
+                + stream_ns(m, cells, size,
+                            turns ? 0 : (double) height * m->line, fill_ns);
+
+        struct Plan best = {
+                "row-major", uarray2_methods_plain,
+                uarray2_methods_plain->map_row_major, 1, 1, row_ns
+        };
+        if (col_ns < best.predicted_ns) {
+                best.name = "col-major";
+                best.map = uarray2_methods_plain->map_col_major;
+                best.predicted_ns = col_ns;
+        }
+
+        /* Block-major, over square shapes and then over rectangles
+         * with a side a whole number of lines long */
+        int best_width = 0, best_height = 0;
+        double best_blocked = 0;
+        int nshapes = sizeof(blocksizes) / sizeof(int);
+        int nrects = sizeof(rect_rows) / sizeof(int);
+        long common = size, rest = m->line;
+        while (rest != 0) {
+                long t = common % rest;
+                common = rest;
+                rest = t;
+        }
+        int unit = m->line / common;    /* cells in a whole-line row */
+        for (int i = 0; i < nshapes + 6 * nrects; i++) {
+                int bw, bh;
+                if (i < nshapes) {
+                        bw = bh = blocksizes[i];
+                        if (bw == 0) {
+                                /* As UArray2b_new_64K_block picks it */
+                                bw = bh = size > 65536 ? 1 :
+                                          (int) sqrt(65536 / size);
+                        }
+                } else {
+                        int k = (i - nshapes) / nrects;
+                        bw = unit << (k % 3);
+                        bh = rect_rows[(i - nshapes) % nrects];
+                        if (k >= 3) {
+                                int t = bw;
+                                bw = bh;
+                                bh = t;
+                        }
+                }
+                double ns = blocked_ns(m, width, height, size, turns, fill_ns,
+                                       bw, bh);
+                if (best_width == 0 || ns < best_blocked) {
+                        best_width = bw;
+                        best_height = bh;
+                        best_blocked = ns;
+                }
+        }
+        if (best_blocked < best.predicted_ns) {
+                best.name = "block-major";
+                best.methods = uarray2_methods_blocked;
+                best.map = uarray2_methods_blocked->map_block_major;
+                best.blk_width = best_width;
+                best.blk_height = best_height;
+                best.predicted_ns = best_blocked;
+        }
+        return best;
+}
+
+/**********Plan_dimensions********
+ * Reads width and height from a P3 or P6 header, skipping comments
+ * Inputs: the image bytes, their number, and where to put the dimensions
+ * Return: false if the header is malformed
+ ************************/
+bool Plan_dimensions(const char *image, size_t length, int *width,
+                     int *height)
+{
+        assert(image != NULL && width != NULL && height != NULL);
+        if (length < 2 || image[0] != 'P' ||
+            (image[1] != '3' && image[1] != '6')) {
+                return false;
+        }
+        size_t i = 2;
+        long dims[2];
+        for (int k = 0; k < 2; k++) {
+                while (i < length && (isspace((unsigned char) image[i]) ||
+                                      image[i] == '#')) {
+                        if (image[i] == '#') {
+                                while (i < length && image[i] != '\n') {
+                                        i++;
+                                }
+                        } else {
+                                i++;
+                        }
+                }
+                if (i == length || !isdigit((unsigned char) image[i])) {
+                        return false;
+                }
+                dims[k] = 0;
+                while (i < length && isdigit((unsigned char) image[i]) &&
+                       dims[k] < (1L << 30)) {
+                        dims[k] = dims[k] * 10 + (image[i++] - '0');
+                }
+        }
+        *width = dims[0];
+        *height = dims[1];
+        return *width > 0 && *height > 0;
+}
+
+/**********Plan_log********
+ * Appends the plan and its predicted and measured cost as a CSV record
+ ************************/
+void Plan_log(FILE *fp, const struct Plan *plan, int width, int height,
+              int angle, double measured_ns)
+{
+        assert(fp != NULL && plan != NULL);
+        if (ftell(fp) == 0) {
+                fprintf(fp, "width,height,angle,plan,blockshape,"
+                            "predicted_ns,measured_ns,measured_over_"
+                            "predicted\n");
+        }
+        fprintf(fp, "%d,%d,%d,%s,%dx%d,%.0f,%.0f,%.3f\n", width, height,
+                angle, plan->name, plan->blk_width, plan->blk_height,
+                plan->predicted_ns, measured_ns,
+                measured_ns / plan->predicted_ns);
+}
+
+/**********cache_size********
+ * Size of one cache level from sysconf, or from /sys when sysconf does
+ * not know it
+ ************************/
+static long cache_size(int name, int level, const char *type)
+{
+        long size = sysconf(name);
+        if (size > 0) {
+                return size;
+        }
+        for (int index = 0; index < 8; index++) {
+                char path[96], kind[16];
+                int found_level;
+                snprintf(path, sizeof(path),
+                         "/sys/devices/system/cpu/cpu0/cache/index%d/level",
+                         index);
+                FILE *fp = fopen(path, "r");
+                if (fp == NULL) {
+                        break;
+                }
+                int ok = fscanf(fp, "%d", &found_level) == 1;
+                fclose(fp);
+
+                snprintf(path, sizeof(path),
+                         "/sys/devices/system/cpu/cpu0/cache/index%d/type",
+                         index);
+                fp = fopen(path, "r");
+                ok = ok && fp != NULL && fscanf(fp, "%15s", kind) == 1;
+                if (fp != NULL) {
+                        fclose(fp);
+                }
+                if (!ok || found_level != level || strcmp(kind, type) != 0) {
+                        continue;
+                }
+
+                snprintf(path, sizeof(path),
+                         "/sys/devices/system/cpu/cpu0/cache/index%d/size",
+                         index);
+                fp = fopen(path, "r");
+                long kb;
+                if (fp != NULL && fscanf(fp, "%ldK", &kb) == 1) {
+                        size = kb * 1024;
+                }
+                if (fp != NULL) {
+                        fclose(fp);
+                }
+                return size;
+        }
+        return 0;
+}
+
+/**********level_ns********
+ * Latency of the first cache level that can hold bytes
+ ************************/
+static double level_ns(const struct Plan_machine *m, double bytes)
+{
+        if (bytes <= m->l2) {
+                return L2_NS;
+        }
+        return bytes <= m->llc ? LLC_NS : DRAM_NS;
+}
+
+/**********stream_ns********
+ * Cost of streaming through cells of the given size: a line fill per
+ * line covered, plus a lower-level access per cell when the lines that
+ * must stay alive for reuse do not fit in L1
+ ************************/
+static double stream_ns(const struct Plan_machine *m, double cells,
+                        int size, double reuse_bytes, double fill_ns)
+{
+        double ns = cells * size / m->line * fill_ns;
+        if (reuse_bytes > m->l1) {
+                ns += cells * level_ns(m, reuse_bytes);
+        }
+        return ns;
+}
+
+/**********blocked_ns********
+ * Predicted cost of a block-major rotation with blk_width x blk_height
+ * blocks. Cells in partial edge blocks are stored but unused. A turned
+ * block writes one destination column per block row, keeping a line
+ * per cell of the row alive, and gives each destination row it reaches
+ * a run of blk_height cells, which fills every line it reaches, the
+ * partly covered one at its end included.
+ ************************/
+static double blocked_ns(const struct Plan_machine *m, int width,
+                         int height, int size, bool turns, double fill_ns,
+                         int blk_width, int blk_height)
+{
+        double cells = (double) width * height;
+        double stored = (double) ((width + blk_width - 1) / blk_width *
+                                  blk_width)
+                        * ((height + blk_height - 1) / blk_height *
+                           blk_height);
+        double blocks = stored / ((double) blk_width * blk_height);
+        double ns = cells * BLOCKED_CELL_NS + blocks * BLOCK_NS
+                + stream_ns(m, stored, size, 0, fill_ns);
+        if (!turns) {
+                return ns + stream_ns(m, stored, size, 0, fill_ns);
+        }
+
+        long run_bytes = (long) blk_height * size;
+        long run_lines = (run_bytes + m->line - 1) / m->line;
+        double reuse = (double) blk_width * m->line;
+        ns += stored / blk_height * run_lines * fill_ns;
+        if (reuse > m->l1) {
+                ns += stored * level_ns(m, reuse);
+        }
+        return ns;
+}
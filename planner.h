@@ -0,0 +1,54 @@
+/**************************************************************
+ *                     planner.h
+ *
+ *     interface for the cost-model planner behind ppmtrans -auto. It
+ *     predicts the time of a rotation for each layout, traversal and
+ *     block shape from the image dimensions, element size, angle and the
+ *     machine's caches, and picks the cheapest.
+ *
+ **************************************************************/
+#ifndef PLANNER_INCLUDED
+#define PLANNER_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "a2methods.h"
+
+struct Plan_machine {
+        long l1, l2, llc;       /* data cache sizes in bytes */
+        long line;              /* cache line size in bytes */
+};
+
+struct Plan {
+        const char *name;       /* "row-major", "col-major", "block-major" */
+        A2Methods_T methods;    /* new_with_blockshape, given blk_width
+                                   and blk_height, makes the rasters */
+        A2Methods_mapfun *map;
+        int blk_width;          /* block shape, 1 x 1 for plain layouts */
+        int blk_height;
+        double predicted_ns;    /* for the whole rotation */
+};
+
+/* Cache parameters from sysconf or /sys, with defaults for the rest */
+extern void Plan_machine(struct Plan_machine *machine);
+
+/* Cheapest plan for rotating a width x height array of size-byte
+ * elements by angle. Plans hold no shared state, so threads may plan
+ * at once.
+ */
+extern struct Plan Plan_choose(const struct Plan_machine *machine,
+                               int width, int height, int size, int angle);
+
+/* Width and height from the header of a ppm held in memory */
+extern bool Plan_dimensions(const char *image, size_t length, int *width,
+                            int *height);
+
+/* Appends one CSV record: dimensions, angle, plan, predicted and
+ * measured ns and their ratio; a header line is written first if fp is
+ * at the start of the file
+ */
+extern void Plan_log(FILE *fp, const struct Plan *plan, int width,
+                     int height, int angle, double measured_ns);
+
+#endif
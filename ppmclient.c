@@ -0,0 +1,329 @@
+/**************************************************************
+ *                     ppmclient.c
+ *
+ *     load-testing client for ppmtrans --serve. Sends the same image
+ *     repeatedly with up to -depth requests in flight and reports
+ *     client-side latency percentiles and throughput. One thread sends
+ *     and another receives, so a deep pipeline cannot deadlock on full
+ *     socket buffers.
+ *
+ **************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "assert.h"
+#include "serve.h"
+
+/* Most requests one run sends; keeps the latency arrays' size in range */
+#define MAX_REQUESTS (1 << 24)
+
+struct load {
+        int fd;
+        int count;              /* requests to send */
+        struct Serve_header header;
+        const char *image;
+        double *sent_us;        /* when each request started going out */
+        double *latency_us;     /* filled in by the receiver */
+        sem_t slots;            /* free places in the pipeline */
+        FILE *last_out;         /* where the final reply goes, or NULL */
+        bool failed;            /* set and read by both threads atomically */
+};
+
+static void usage(const char *progname);
+static int connect_to(const char *path);
+static char *read_file(const char *name, size_t *length);
+static void *sender(void *vload);
+static void *receiver(void *vload);
+static int fetch_stats(int fd);
+static double now_us(void);
+static int compare_doubles(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+        int angle = 0;
+        int layout = SERVE_ROW_MAJOR;
+        int count = 1;
+        int depth = 1;
+        bool stats_only = false;
+        char *out_name = NULL;
+        char *socket_name = NULL;
+        char *image_name = NULL;
+        int i;
+
+        for (i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-rotate") == 0 && i + 1 < argc) {
+                        char *endptr;
+                        angle = strtol(argv[++i], &endptr, 10);
+                        if (*endptr != '\0' ||
+                            !(angle == 0 || angle == 90 || angle == 180 ||
+                              angle == 270)) {
+                                fprintf(stderr,
+                                        "Rotation must be 0, 90 180 or 270\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-layout") == 0 && i + 1 < argc) {
+                        i++;
+                        if (strcmp(argv[i], "row-major") == 0) {
+                                layout = SERVE_ROW_MAJOR;
+                        } else if (strcmp(argv[i], "col-major") == 0) {
+                                layout = SERVE_COL_MAJOR;
+                        } else if (strcmp(argv[i], "block-major") == 0) {
+                                layout = SERVE_BLOCK_MAJOR;
+                        } else if (strcmp(argv[i], "compressed") == 0) {
+                                layout = SERVE_COMPRESSED;
+                        } else {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+                        count = atoi(argv[++i]);
+                } else if (strcmp(argv[i], "-depth") == 0 && i + 1 < argc) {
+                        depth = atoi(argv[++i]);
+                } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                        out_name = argv[++i];
+                } else if (strcmp(argv[i], "-stats") == 0) {
+                        stats_only = true;
+                } else if (*argv[i] == '-') {
+                        usage(argv[0]);
+                } else if (socket_name == NULL) {
+                        socket_name = argv[i];
+                } else if (image_name == NULL) {
+                        image_name = argv[i];
+                } else {
+                        usage(argv[0]);
+                }
+        }
+        if (socket_name == NULL || (image_name == NULL && !stats_only) ||
+            count < 1 || count > MAX_REQUESTS || depth < 1) {
+                usage(argv[0]);
+        }
+
+        int fd = connect_to(socket_name);
+        if (stats_only) {
+                int rc = fetch_stats(fd);
+                close(fd);
+                return rc;
+        }
+
+        size_t length;
+        struct load load;
+        load.fd = fd;
+        load.count = count;
+        load.image = read_file(image_name, &length);
+        load.header = (struct Serve_header) {
+                SERVE_MAGIC, SERVE_TRANSFORM, angle, layout, length
+        };
+        load.sent_us = malloc((size_t) count * sizeof(double));
+        load.latency_us = malloc((size_t) count * sizeof(double));
+        assert(load.sent_us != NULL && load.latency_us != NULL);
+        sem_init(&load.slots, 0, depth);
+        load.last_out = NULL;
+        if (out_name != NULL) {
+                load.last_out = fopen(out_name, "wb");
+                if (load.last_out == NULL) {
+                        perror(out_name);
+                        exit(1);
+                }
+        }
+        load.failed = false;
+
+        double start = now_us();
+        pthread_t send_thread, recv_thread;
+        pthread_create(&send_thread, NULL, sender, &load);
+        pthread_create(&recv_thread, NULL, receiver, &load);
+        pthread_join(send_thread, NULL);
+        pthread_join(recv_thread, NULL);
+        double wall_us = now_us() - start;
+
+        if (load.failed) {
+                fprintf(stderr, "%s: request failed\n", argv[0]);
+                exit(1);
+        }
+        qsort(load.latency_us, count, sizeof(double), compare_doubles);
+        printf("requests %d\ndepth %d\nwall_s %.3f\nrequests_per_s %.1f\n"
+               "latency_p50_us %.1f\nlatency_p90_us %.1f\n"
+               "latency_p99_us %.1f\nlatency_max_us %.1f\n",
+               count, depth, wall_us / 1e6, count / (wall_us / 1e6),
+               load.latency_us[(count - 1) * 50 / 100],
+               load.latency_us[(count - 1) * 90 / 100],
+               load.latency_us[(count - 1) * 99 / 100],
+               load.latency_us[count - 1]);
+
+        if (load.last_out != NULL) {
+                fclose(load.last_out);
+        }
+        sem_destroy(&load.slots);
+        free(load.sent_us);
+        free(load.latency_us);
+        free((char *) load.image);
+        close(fd);
+        return 0;
+}
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-rotate <angle>] "
+                        "[-layout {row,col,block}-major|compressed] "
+                        "[-n <requests>] [-depth <in flight>] [-o <file>] "
+                        "<socket> <image>\n"
+                        "       %s -stats <socket>\n",
+                        progname, progname);
+        exit(1);
+}
+
+/**********connect_to********
+ * Connects to the daemon's socket, exiting on failure
+ ************************/
+static int connect_to(const char *path)
+{
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr.sun_path)) {
+                fprintf(stderr, "Socket path too long: %s\n", path);
+                exit(1);
+        }
+        strcpy(addr.sun_path, path);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *) &addr,
+                              sizeof(addr)) < 0) {
+                perror(path);
+                exit(1);
+        }
+        return fd;
+}
+
+/**********read_file********
+ * Reads a whole file into memory, exiting on failure
+ ************************/
+static char *read_file(const char *name, size_t *length)
+{
+        FILE *fp = fopen(name, "rb");
+        if (fp == NULL) {
+                perror(name);
+                exit(1);
+        }
+        size_t capacity = 1 << 16;
+        char *buf = malloc(capacity);
+        assert(buf != NULL);
+        *length = 0;
+        size_t n;
+        while ((n = fread(buf + *length, 1, capacity - *length, fp)) > 0) {
+                *length += n;
+                if (*length == capacity) {
+                        capacity *= 2;
+                        buf = realloc(buf, capacity);
+                        assert(buf != NULL);
+                }
+        }
+        fclose(fp);
+        return buf;
+}
+
+/**********sender********
+ * Sends every request, waiting whenever the pipeline is full
+ ************************/
+static void *sender(void *vload)
+{
+        struct load *load = vload;
+        for (int i = 0; i < load->count; i++) {
+                if (__atomic_load_n(&load->failed, __ATOMIC_RELAXED)) {
+                        break;
+                }
+                sem_wait(&load->slots);
+                load->sent_us[i] = now_us();
+                if (Serve_write_all(load->fd, &load->header,
+                                    sizeof(load->header)) != 0 ||
+                    Serve_write_all(load->fd, load->image,
+                                    load->header.length) != 0) {
+                        __atomic_store_n(&load->failed, true,
+                                         __ATOMIC_RELAXED);
+                }
+        }
+        return NULL;
+}
+
+/**********receiver********
+ * Reads the replies in order, timing each against its send
+ ************************/
+static void *receiver(void *vload)
+{
+        struct load *load = vload;
+        char *body = NULL;
+        size_t capacity = 0;
+
+        for (int i = 0; i < load->count; i++) {
+                struct Serve_reply reply;
+                if (Serve_read_all(load->fd, &reply, sizeof(reply)) != 0) {
+                        __atomic_store_n(&load->failed, true,
+                                         __ATOMIC_RELAXED);
+                        break;
+                }
+                if (reply.length > capacity) {
+                        free(body);
+                        capacity = reply.length;
+                        body = malloc(capacity);
+                        assert(body != NULL);
+                }
+                if (Serve_read_all(load->fd, body, reply.length) != 0 ||
+                    reply.status != 0) {
+                        __atomic_store_n(&load->failed, true,
+                                         __ATOMIC_RELAXED);
+                        break;
+                }
+                load->latency_us[i] = now_us() - load->sent_us[i];
+                if (i == load->count - 1 && load->last_out != NULL) {
+                        fwrite(body, 1, reply.length, load->last_out);
+                }
+                sem_post(&load->slots);
+        }
+        /* Lets a blocked sender see the failure */
+        sem_post(&load->slots);
+        free(body);
+        return NULL;
+}
+
+/**********fetch_stats********
+ * Asks the daemon for its statistics and prints them
+ ************************/
+static int fetch_stats(int fd)
+{
+        struct Serve_header header = { SERVE_MAGIC, SERVE_STATS, 0, 0, 0 };
+        struct Serve_reply reply;
+        if (Serve_write_all(fd, &header, sizeof(header)) != 0 ||
+            Serve_read_all(fd, &reply, sizeof(reply)) != 0) {
+                fprintf(stderr, "stats request failed\n");
+                return 1;
+        }
+        char *text = malloc(reply.length + 1);
+        assert(text != NULL);
+        if (Serve_read_all(fd, text, reply.length) != 0) {
+                free(text);
+                return 1;
+        }
+        fwrite(text, 1, reply.length, stdout);
+        free(text);
+        return 0;
+}
+
+static double now_us(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+        double x = *(const double *) a;
+        double y = *(const double *) b;
+        return (x > y) - (x < y);
+}
@@ -16,12 +16,76 @@
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "uarray2b.h"
+#include "a2view.h"
+#include "rasterpool.h"
+#include "serve.h"
+#include "pipeline.h"
+#include "parallel.h"
+#include "numa.h"
+#include "planner.h"
+#include "planar.h"
+#include "perfcount.h"
+#include "dihedral.h"
+#include "stats.h"
+#include "trace.h"
+#include "memacct.h"
+#include "padding.h"
+#include "rotate.h"
 #include "pnm.h"
 #include "cputiming.h"
 
-struct closure {
-        A2Methods_UArray2 raster;
-        A2Methods_T arrayfxns;
+/* Shared by the threads of a parallel rotation, which split the
+ * destination and pull each of their cells from the source
+ */
+struct par_closure {
+        A2Methods_UArray2 source;
+        A2Methods_UArray2 dest;
+        A2Methods_T methods;
+        Dihedral_T inverse;             /* destination cell to source cell */
+        int width, height;              /* of the destination */
+        struct Stats *partials;         /* one per thread, or NULL */
+        unsigned denominator;
+};
+
+/* One thread's share of a rotation, with statistics fused in when
+ * partial is not NULL */
+struct fused {
+        struct par_closure *par;
+        struct Stats *partial;
+};
+
+/* Where the lookahead of a scheduled rotation prefetches its writes */
+struct lookahead {
+        UArray2b_T dest;
+        Dihedral_T op;
+        int width, height;      /* of the source */
+};
+
+/* How UArray2b_place should place the blocks of a parallel rotation */
+struct placement {
+        int policy;
+        int nthreads;
+};
+
+/* How UArray2b_place_owned should place the source of a parallel
+ * rotation: each block goes where the thread whose destination run it
+ * rotates onto lives
+ */
+struct source_placement {
+        struct placement how;
+        UArray2b_T dest;
+        Dihedral_T op;
+        int width, height;      /* of the source */
+};
+
+/* A sequential rotation with statistics folded in: each cell is
+ * accumulated into stats as it is handed to rotate */
+struct counted {
+        struct closure *trans;
+        A2Methods_applyfun *rotate;
+        struct Stats *stats;
+        unsigned denominator;
 };
 
 #define SET_METHODS(METHODS, MAP, WHAT) do {                    \
@@ -36,13 +100,118 @@ struct closure {
         }                                                       \
 } while (false)
 
+/* Bytes of a raster of the given size, and of a ppm's P6 encoding; the
+ * phases of a rotation report what they moved in these terms
+ */
+static size_t raster_bytes(int width, int height)
+{
+        return (size_t) width * height * sizeof(struct Pnm_rgb);
+}
+
+static size_t ppm_bytes(Pnm_ppm ppm)
+{
+        return (size_t) ppm->width * ppm->height * 3 *
+               (ppm->denominator < 256 ? 1 : 2);
+}
+
+/* Three planes of 16-bit samples */
+static size_t planes_bytes(int width, int height)
+{
+        return (size_t) width * height * 3 * 2;
+}
+
+/* A suite over UArray2b blocks: the blocked suite itself or a copy of it
+ * (the daemon's raster pool replaces new and free), but not the
+ * packed one
+ */
+static bool blocked_suite(A2Methods_T methods)
+{
+        return methods->map_block_major != NULL &&
+               methods != uarray2_methods_compressed;
+}
+
+/**********write_ppm********
+ * Writes a pixmap as a binary (P6) ppm, like Pnm_ppmwrite but reading
+ * every pixel through methods->get: a packed block that is only read is
+ * not marked dirty, so it is dropped rather than packed again when it
+ * is evicted
+ ************************/
+static void write_ppm(FILE *out, Pnm_ppm img)
+{
+        const struct A2Methods_T *methods = img->methods;
+        bool wide = img->denominator > 255;
+        size_t row_bytes = (size_t) img->width * 3 * (wide ? 2 : 1);
+        unsigned char *line = malloc(row_bytes);
+        assert(line != NULL && methods->get != NULL);
+
+        fprintf(out, "P6\n%u %u\n%u\n", img->width, img->height,
+                img->denominator);
+        for (unsigned row = 0; row < img->height; row++) {
+                unsigned char *next = line;
+                for (unsigned col = 0; col < img->width; col++) {
+                        const struct Pnm_rgb *pixel =
+                                (const struct Pnm_rgb *) methods->get(
+                                        img->pixels, col, row);
+                        unsigned samples[3] = { pixel->red, pixel->green,
+                                                pixel->blue };
+                        for (int k = 0; k < 3; k++) {
+                                if (wide) {
+                                        *next++ = samples[k] >> 8;
+                                }
+                                *next++ = samples[k];
+                        }
+                }
+                fwrite(line, 1, row_bytes, out);
+        }
+        free(line);
+}
+
+/**********rotate_counted********
+ * Apply function that folds a source pixel into the statistics, then
+ * rotates it with the apply function it wraps
+ ************************/
+static void rotate_counted(int col, int row, A2Methods_UArray2 arr,
+                           void *elem, void *cl)
+{
+        struct counted *counted = cl;
+        Stats_accumulate(col, row, elem, counted->stats,
+                         &counted->denominator);
+        counted->rotate(col, row, arr, elem, counted->trans);
+}
+
+/**********map_rotation********
+ * Maps rotate over the source with trans as its closure, accumulating
+ * every source pixel into stats on the way if stats is not NULL
+ ************************/
+static void map_rotation(A2Methods_mapfun map, Pnm_ppm img,
+                         A2Methods_applyfun *rotate, struct closure *trans,
+                         struct Stats *stats)
+{
+        if (stats == NULL) {
+                map(img->pixels, rotate, trans);
+                return;
+        }
+        struct counted counted = { trans, rotate, stats, img->denominator };
+        map(img->pixels, (A2Methods_applyfun *) rotate_counted, &counted);
+}
+
 
 static void
 usage(const char *progname)
 {
         fprintf(stderr, "Usage: %s [-rotate <angle>] "
-                        "[-{row,col,block}-major] [filename]\n",
-                        progname);
+                        "[-{row,col,block}-major] [-compressed] "
+                        "[-lazy] [-crop <col> <row> <width> <height>] "
+                        "[-pipeline] [-parallel] [-workers <n>] "
+                        "[-numa first-touch|interleave|bind] "
+                        "[-numa-sim <nodes>] [-auto] [-plan-log <file>] "
+                        "[-blockshape <w>x<h>] "
+                        "[-planar] [-prefetch <blocks>] [-serpentine] "
+                        "[-padding auto|none] [-hilbert] [-hilbert-cells] "
+                        "[-stats <file>] [-trace <file>] "
+                        "[-time <file>] [filename]\n"
+                        "       %s --serve <socket> [-workers <n>]\n",
+                        progname, progname);
         exit(1);
 }
 
@@ -51,114 +220,178 @@ usage(const char *progname)
  * calls rotation functions and measures the time taken to complete them
  * Inputs:
  *              Pnm_ppm orig_img: original image read in Pnm.h
+ *              FILE *out: where the rotated image is written
  *              A2Methods_T methods: method suite of function pointers
  *              A2Methods_mapfun: map function which will traverse the image 
  *                                raster
  *              int angle: angle of rotation to be performed on image
  *              bool timer: boolean which is true if timing flag is given
+ *              struct Stats *stats: if not NULL, set to the statistics of
+ *                                   the original image, gathered as the
+ *                                   rotation visits each pixel
  * Return:      time taken to complete the rotation
  * Expects:
  *              more than 1 command line argument to be supplied
  * Notes:
  *              assert exists to check if insufficient args are inputted
 ************************/
-double trans_ppm(Pnm_ppm orig_img, A2Methods_T methods, A2Methods_mapfun map, 
-        int angle, bool timer);
+double trans_ppm(Pnm_ppm orig_img, FILE *out, A2Methods_T methods,
+        A2Methods_mapfun map, int angle, bool timer, struct Stats *stats);
 
-/**********cl_maker********
+/**********view_ppm********
  *
- * Assigns required values to closure struct for transformation mapping
+ * writes the rotated (and optionally cropped) image through a lazy view,
+ * so only the cells that are written out are ever visited
  * Inputs:
- *              int width: The desired width of the rotated image
- *              int height: The desired height of the rotated image
- *              struct closure *cl: The closure struct being updated
- *              A2Methods_T methods: Methods suite containing A2 
- *                                   manipulation functions
- * Return:      n/a
+ *              Pnm_ppm orig_img: original image read in Pnm.h
+ *              FILE *out: where the image is written
+ *              A2Methods_T methods: method suite that reads the raster
+ *              int angle: angle of rotation to be performed on image
+ *              const int *crop: col, row, width and height of the part of
+ *                               the rotated image to keep, or NULL
+ *              bool timer: boolean which is true if timing flag is given
+ * Return:      time taken to write the view
+ * Expects:
+ *              crop to lie inside the rotated image
+ * Notes:
+ *              orig_img is left untouched
+************************/
+double view_ppm(Pnm_ppm orig_img, FILE *out, A2Methods_T methods, int angle,
+        const int *crop, bool timer);
+
+/**********serve_image********
+ *
+ * request handler for --serve: reads one binary (P6) image from memory,
+ * rotates it with the requested layout and writes the result to out
+ * Inputs:
+ *              const char *image: the image file's bytes
+ *              size_t length: number of bytes in image
+ *              FILE *out: where the rotated image is written
+ *              int angle: angle of rotation to be performed on image
+ *              int layout: one of the SERVE_ layouts
+ * Return:      0 on success, nonzero for a bad request
  * Expects:     n/a
  * Notes:
+ *              the image is checked up front because Pnm_ppmread reports
+ *              bad input by raising an exception, which would take the
+ *              whole daemon down
 ************************/
-void cl_maker(int width, int height, struct closure *cl, A2Methods_T methods);
+int serve_image(const char *image, size_t length, FILE *out, int angle,
+        int layout);
 
-/**********rotate90********
+/**********ppm_complete********
  *
- * apply function to do 90 degree image rotation
+ * checks that a buffer holds a whole binary ppm without comments
  * Inputs:
- *              int col: column index of a cell
- *              int row: row index of a cell
- *              A2Methods_UArray2 arr: UArray2b object which will hold the
-                                       updated image raster
-                void *elem: A pointer to the element at index (col, row)
-                void *cl_trans: pointer to the closure struct
-                
- * Return:      n/a
+ *              const char *image: the image file's bytes
+ *              size_t length: number of bytes in image
+ * Return:      true if Pnm_ppmread can read the buffer
+ * Expects:     n/a
+************************/
+bool ppm_complete(const char *image, size_t length);
+
+/**********par_trans_ppm********
+ *
+ * rotates the image on several threads, each owning a contiguous run of
+ * blocks (blocked methods) or rows (plain methods), and places the
+ * rasters so each run, and the source blocks it reads, live on the
+ * NUMA node of its thread
+ * Inputs:
+ *              Pnm_ppm orig_img: original image read in Pnm.h
+ *              FILE *out: where the rotated image is written
+ *              A2Methods_T methods: plain or blocked method suite
+ *              int angle: angle of rotation to be performed on image
+ *              int nthreads: number of rotating threads
+ *              int policy: one of the NUMA_ placement policies
+ *              bool timer: boolean which is true if timing flag is given
+ *              struct Stats *stats: if not NULL, set to the statistics of
+ *                                   the original image, gathered by the
+ *                                   rotating threads as they go
+ * Return:      time taken to complete the rotation
  * Expects:
- *              more than 1 command line argument to be supplied
+ *              methods is not the compressed suite
  * Notes:
- *              assert exists to check if insufficient args are inputted
+ *              the threads split the destination, so each writes only
+ *              what it first touched; plain rasters are one opaque
+ *              allocation, so they can only be placed by first touch
 ************************/
-void rotate90(int col, int row, A2Methods_UArray2 arr, void *elem, 
-        void *cl_trans);
+double par_trans_ppm(Pnm_ppm orig_img, FILE *out, A2Methods_T methods,
+        int angle, int nthreads, int policy, bool timer, struct Stats *stats);
 
-/**********rotate180********
+/**********sched_trans_ppm********
  *
- * apply function to do 180 degree image rotation
+ * rotates a blocked image with UArray2b_map_scheduled: the blocks can be
+ * visited in serpentine order, and while each block is rotated the source
+ * block distance places ahead, and the cells its rotation will write, are
+ * prefetched
  * Inputs:
- *              int col: column index of a cell
- *              int row: row index of a cell
- *              A2Methods_UArray2 arr: UArray2b object which will hold the
-                                       updated image raster
-                void *elem: A pointer to the element at index (col, row)
-                void *cl_trans: pointer to the closure struct
-                
- * Return:      n/a
+ *              Pnm_ppm orig_img: original image read in Pnm.h
+ *              FILE *out: where the rotated image is written
+ *              A2Methods_T methods: the blocked method suite
+ *              int angle: angle of rotation to be performed on image
+ *              int distance: blocks to look ahead, 0 for no prefetching
+ *              bool serpentine: true to reverse every other row of blocks
+ *              bool timer: boolean which is true if timing flag is given
+ *              struct Stats *stats: if not NULL, set to the statistics of
+ *                                   the original image, gathered as the
+ *                                   rotation visits each pixel
+ * Return:      time taken to complete the rotation
  * Expects:
- *              more than 1 command line argument to be supplied
+ *              methods is uarray2_methods_blocked
  * Notes:
- *              assert exists to check if insufficient args are inputted
+ *              the hardware counters are read around the rotation when
+ *              timing, for Perf_read
 ************************/
-void rotate180(int col, int row, A2Methods_UArray2 arr, void *elem, 
-        void *cl_trans);
+double sched_trans_ppm(Pnm_ppm orig_img, FILE *out, A2Methods_T methods,
+        int angle, int distance, bool serpentine, bool timer,
+        struct Stats *stats);
 
-/**********rotate270********
+/**********planar_ppm********
  *
- * apply function to do 270 degree image rotation
+ * rotates the image in planar form: the pixels are split into red,
+ * green and blue planes, each plane is rotated on its own, and the
+ * planes are interleaved again as the image is written
  * Inputs:
- *              int col: column index of a cell
- *              int row: row index of a cell
- *              A2Methods_UArray2 arr: UArray2b object which will hold the
-                                       updated image raster
-                void *elem: A pointer to the element at index (col, row)
-                void *cl_trans: pointer to the closure struct
-                
- * Return:      n/a
+ *              Pnm_ppm orig_img: original image read in Pnm.h
+ *              FILE *out: where the rotated image is written
+ *              A2Methods_T methods: method suite that reads the raster
+ *              int blocksize: side of the planes' blocks, 1 for plain
+ *              int angle: angle of rotation to be performed on image
+ *              bool timer: boolean which is true if timing flag is given
+ *              double *convert: set to the time spent splitting and
+ *                               interleaving, if timer is true
+ * Return:      time taken to rotate the planes
  * Expects:
- *              more than 1 command line argument to be supplied
- * Notes:
- *              assert exists to check if insufficient args are inputted
+ *              the image's samples fit in 16 bits
+************************/
+double planar_ppm(Pnm_ppm orig_img, FILE *out, A2Methods_T methods,
+        int blocksize, int angle, bool timer, double *convert);
+
+/**********read_stream********
+ *
+ * reads everything left in a stream into memory
+ * Inputs:
+ *              FILE *fp: the stream to read
+ *              size_t *length: set to the number of bytes read
+ * Return:      the bytes, which the caller frees
+ * Expects:     fp is open for reading
 ************************/
-void rotate270(int col, int row, A2Methods_UArray2 arr, void *elem, 
-        void *cl_trans);
+char *read_stream(FILE *fp, size_t *length);
 
-/**********rotate0********
+/**********cl_maker********
  *
- * apply function to do 0 degree image rotation
+ * Assigns required values to closure struct for transformation mapping
  * Inputs:
- *              int col: column index of a cell
- *              int row: row index of a cell
- *              A2Methods_UArray2 arr: UArray2b object which will hold the
-                                       updated image raster
-                void *elem: A pointer to the element at index (col, row)
-                void *cl_trans: pointer to the closure struct
-                
+ *              int width: The desired width of the rotated image
+ *              int height: The desired height of the rotated image
+ *              struct closure *cl: The closure struct being updated
+ *              A2Methods_T methods: Methods suite containing A2 
+ *                                   manipulation functions
  * Return:      n/a
- * Expects:
- *              more than 1 command line argument to be supplied
+ * Expects:     n/a
  * Notes:
- *              assert exists to check if insufficient args are inputted
 ************************/
-void rotate0(int col, int row, A2Methods_UArray2 arr, void *elem, 
-        void *cl_trans);
+void cl_maker(int width, int height, struct closure *cl, A2Methods_T methods);
 
 int main(int argc, char *argv[]) 
 {
@@ -166,6 +399,31 @@ int main(int argc, char *argv[])
         int   rotation       = 0;
         int   i;
         bool time_included = false;
+        bool lazy = false;
+        int crop[4];
+        bool crop_included = false;
+        char *serve_path = NULL;
+        int workers = 4;
+        bool pipelined = false;
+        bool parallel = false;
+        int numa_policy = NUMA_FIRST_TOUCH;
+        int numa_sim = 0;
+        bool autoplan = false;
+        bool planar = false;
+        int prefetch = -1;
+        bool serpentine = false;
+        int padding = PADDING_AUTO;
+        bool hilbert = false;
+        bool hilbert_cells = false;
+        int shape[2] = { 0, 0 };
+        FILE *stats_fptr = NULL;
+        FILE *trace_fptr = NULL;
+        struct Stats stats;
+        double convert_time = 0.0;
+        FILE *plan_fptr = NULL;
+        struct Plan plan;
+        int plan_width = 0, plan_height = 0;
+        char *image = NULL;
 
         
         /* default to UArray2 methods */
@@ -178,7 +436,7 @@ int main(int argc, char *argv[])
         
         /* Defaults file to stdin */
         FILE *filename = stdin;
-        FILE *time_fptr;
+        FILE *time_fptr = NULL;
         
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-row-major") == 0) {
@@ -190,6 +448,9 @@ int main(int argc, char *argv[])
                 } else if (strcmp(argv[i], "-block-major") == 0) {
                         SET_METHODS(uarray2_methods_blocked, map_block_major,
                                     "block-major");
+                } else if (strcmp(argv[i], "-compressed") == 0) {
+                        SET_METHODS(uarray2_methods_compressed,
+                                    map_block_major, "block-major");
                 } else if (strcmp(argv[i], "-rotate") == 0) {
                         if (!(i + 1 < argc)) {      /* no rotate value */
                                 usage(argv[0]);
@@ -208,11 +469,157 @@ int main(int argc, char *argv[])
                         }
                         /* Call functions for rotation here */
 
+                } else if (strcmp(argv[i], "--serve") == 0) {
+                        if (!(i + 1 < argc)) {      /* no socket path */
+                                usage(argv[0]);
+                        }
+                        serve_path = argv[++i];
+                } else if (strcmp(argv[i], "-workers") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        workers = atoi(argv[++i]);
+                        if (workers < 1) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-pipeline") == 0) {
+                        pipelined = true;
+                } else if (strcmp(argv[i], "-parallel") == 0) {
+                        parallel = true;
+                } else if (strcmp(argv[i], "-numa") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        i++;
+                        if (strcmp(argv[i], "first-touch") == 0) {
+                                numa_policy = NUMA_FIRST_TOUCH;
+                        } else if (strcmp(argv[i], "interleave") == 0) {
+                                numa_policy = NUMA_INTERLEAVE;
+                        } else if (strcmp(argv[i], "bind") == 0) {
+                                numa_policy = NUMA_BIND;
+                        } else {
+                                usage(argv[0]);
+                        }
+                        parallel = true;
+                } else if (strcmp(argv[i], "-numa-sim") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        numa_sim = atoi(argv[++i]);
+                        if (numa_sim < 1 || numa_sim > 64) {
+                                usage(argv[0]);
+                        }
+                        parallel = true;
+                } else if (strcmp(argv[i], "-auto") == 0) {
+                        autoplan = true;
+                } else if (strcmp(argv[i], "-plan-log") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        plan_fptr = fopen(argv[++i], "a");
+                        if (plan_fptr == NULL) {
+                                fprintf(stderr, "%s: cannot open %s\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                        autoplan = true;
+                } else if (strcmp(argv[i], "-prefetch") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        prefetch = strtol(argv[++i], &endptr, 10);
+                        if (!(*endptr == '\0') || prefetch < 0) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-stats") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        stats_fptr = fopen(argv[++i], "w");
+                        if (stats_fptr == NULL) {
+                                fprintf(stderr, "%s: cannot open %s\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "-trace") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        trace_fptr = fopen(argv[++i], "w");
+                        if (trace_fptr == NULL) {
+                                fprintf(stderr, "%s: cannot open %s\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                        Trace_enable();
+                } else if (strcmp(argv[i], "-blockshape") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        int end = 0;
+                        if (sscanf(argv[++i], "%dx%d%n", &shape[0],
+                                   &shape[1], &end) != 2 ||
+                            argv[i][end] != '\0' || shape[0] < 1 ||
+                            shape[1] < 1) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-serpentine") == 0) {
+                        serpentine = true;
+                } else if (strcmp(argv[i], "-hilbert") == 0) {
+                        hilbert = true;
+                } else if (strcmp(argv[i], "-hilbert-cells") == 0) {
+                        hilbert = true;
+                        hilbert_cells = true;
+                } else if (strcmp(argv[i], "-padding") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        i++;
+                        if (strcmp(argv[i], "auto") == 0) {
+                                padding = PADDING_AUTO;
+                        } else if (strcmp(argv[i], "none") == 0) {
+                                padding = PADDING_NONE;
+                        } else {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-planar") == 0) {
+                        planar = true;
+                } else if (strcmp(argv[i], "-lazy") == 0) {
+                        lazy = true;
+                } else if (strcmp(argv[i], "-crop") == 0) {
+                        if (!(i + 4 < argc)) {      /* missing rectangle */
+                                usage(argv[0]);
+                        }
+                        for (int k = 0; k < 4; k++) {
+                                char *endptr;
+                                crop[k] = strtol(argv[++i], &endptr, 10);
+                                if (!(*endptr == '\0') || crop[k] < 0) {
+                                        usage(argv[0]);
+                                }
+                        }
+                        if (crop[2] == 0 || crop[3] == 0) {
+                                fprintf(stderr, "Crop must not be empty\n");
+                                usage(argv[0]);
+                        }
+                        /* A crop is always done through a view */
+                        crop_included = true;
+                        lazy = true;
                 } else if (strcmp(argv[i], "-time") == 0) {
+                        if (!(i + 1 < argc)) {      /* no timing file */
+                                usage(argv[0]);
+                        }
                         time_file_name = argv[++i];
                         time_included = true;
                         /* Opens timing file */
                         time_fptr = fopen(time_file_name, "a");
+                        if (time_fptr == NULL) {
+                                fprintf(stderr, "%s: cannot open %s\n",
+                                        argv[0], time_file_name);
+                                exit(1);
+                        }
+                        /* One line of JSON per run, summing the trace */
+                        Trace_enable();
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n", argv[0],
                                 argv[i]);
@@ -226,86 +633,355 @@ int main(int argc, char *argv[])
                         if (filename == NULL) {
                                 fprintf(stderr, "File not able to be opened\n");
                         }
-                        if (time_included) {
-                                fprintf(time_fptr, "Filename: %s\n", argv[i]);
-                        }
+                        Trace_note_str("file", argv[i]);
+                }
+        }
+        /* Daemon mode: requests carry their own images and options */
+        if (serve_path != NULL) {
+                if (shape[0] > 0) {
+                        fprintf(stderr, "%s: --serve takes each raster's "
+                                "layout from its request, so it cannot "
+                                "take -blockshape\n", argv[0]);
+                        exit(1);
+                }
+                exit(Serve_run(serve_path, workers, serve_image) == 0 ?
+                     EXIT_SUCCESS : EXIT_FAILURE);
+        }
+
+        /* Rows of plain rasters and blocks of blocked ones */
+        Padding_set(padding);
+        Trace_note_str("padding", padding == PADDING_NONE ? "none" : "auto");
+
+        if (planar && (lazy || pipelined || parallel || autoplan ||
+                       methods == uarray2_methods_compressed)) {
+                fprintf(stderr, "%s: -planar only combines with "
+                        "-row-major, -col-major and -block-major\n",
+                        argv[0]);
+                exit(1);
+        }
+
+        /* Statistics are gathered by the pass that rotates each pixel,
+         * which a lazy view or a planar rotation does not make */
+        if (stats_fptr != NULL && (lazy || planar)) {
+                fprintf(stderr, "%s: -stats cannot be combined with "
+                        "-lazy, -crop or -planar\n", argv[0]);
+                exit(1);
+        }
+
+        /* Every blocked raster from here on has the given shape */
+        if (shape[0] > 0) {
+                /* The compressed suite has no new_with_blockshape */
+                if (methods == uarray2_methods_compressed) {
+                        fprintf(stderr, "%s: -blockshape cannot be combined "
+                                "with -compressed, whose blocks are always "
+                                "square\n", argv[0]);
+                        exit(1);
+                }
+                if (methods != uarray2_methods_blocked || planar ||
+                    autoplan) {
+                        fprintf(stderr, "%s: -blockshape needs "
+                                "-block-major, without -planar or -auto\n",
+                                argv[0]);
+                        exit(1);
+                }
+                A2Blocked_set_shape(shape[0], shape[1]);
+        }
+
+        bool scheduled = prefetch >= 0 || serpentine;
+        if (scheduled && (methods != uarray2_methods_blocked || planar ||
+                          lazy || pipelined || parallel || autoplan)) {
+                fprintf(stderr, "%s: -prefetch and -serpentine need "
+                        "-block-major and no other mode\n", argv[0]);
+                exit(1);
+        }
+
+        /* Walks the source along a Hilbert curve instead */
+        if (hilbert) {
+                if (planar || lazy || pipelined || parallel || autoplan ||
+                    scheduled || methods == uarray2_methods_compressed) {
+                        fprintf(stderr, "%s: -hilbert only combines with "
+                                "-row-major, -col-major and -block-major\n",
+                                argv[0]);
+                        exit(1);
+                }
+                A2Blocked_set_hilbert_cells(hilbert_cells);
+                map = methods->map_hilbert;
+                assert(map != NULL);
+                Trace_note_str("order",
+                               hilbert_cells ? "hilbert-cells" : "hilbert");
+        }
+
+        /* Picks the layout from the header, then reads from memory */
+        if (autoplan) {
+                if (lazy || pipelined || parallel) {
+                        fprintf(stderr, "%s: -auto plans the sequential "
+                                "rotation and cannot be combined with "
+                                "-lazy, -crop, -pipeline or -parallel\n",
+                                argv[0]);
+                        exit(1);
+                }
+                size_t length;
+                image = read_stream(filename, &length);
+                if (!Plan_dimensions(image, length, &plan_width,
+                                     &plan_height)) {
+                        fprintf(stderr, "%s: -auto needs a ppm image\n",
+                                argv[0]);
+                        exit(1);
+                }
+                struct Plan_machine machine;
+                Plan_machine(&machine);
+                plan = Plan_choose(&machine, plan_width, plan_height,
+                                   sizeof(struct Pnm_rgb), rotation);
+                methods = plan.methods;
+                map = plan.map;
+                /* Pnm_ppmread and the rotation make rasters with new */
+                if (methods == uarray2_methods_blocked) {
+                        A2Blocked_set_shape(plan.blk_width, plan.blk_height);
+                }
+                fclose(filename);
+                filename = fmemopen(image, length, "rb");
+                assert(filename != NULL);
+        }
+
+        /* Reads, rotates and writes at once, strip by strip */
+        if (pipelined) {
+                if (lazy || parallel ||
+                    methods == uarray2_methods_compressed ||
+                    stats_fptr != NULL) {
+                        fprintf(stderr, "%s: -pipeline cannot be combined "
+                                "with -lazy, -crop, -parallel, -numa, "
+                                "-compressed or -stats\n", argv[0]);
+                        exit(1);
+                }
+                struct Pipeline_stats stats;
+                Trace_note_num("rotation", rotation);
+                if (Pipeline_run(filename, stdout, methods, rotation,
+                                 workers, &stats) != 0) {
+                        fprintf(stderr, "%s: -pipeline needs a complete "
+                                "binary (P6) image\n", argv[0]);
+                        exit(1);
+                }
+                Trace_note_num("pixels", stats.width * stats.height);
+                Trace_note_num("wall_ns", stats.wall);
+                Trace_note_num("reader_busy_ns", stats.read);
+                Trace_note_num("workers", workers);
+                Trace_note_num("workers_busy_ns", stats.transform);
+                Trace_note_num("writer_busy_ns", stats.write);
+                if (time_included) {
+                        Mem_note();
+                        Trace_write_summary(time_fptr);
+                        fclose(time_fptr);
                 }
+                if (trace_fptr != NULL) {
+                        Trace_write_chrome(trace_fptr);
+                        fclose(trace_fptr);
+                }
+                fclose(filename);
+                exit(EXIT_SUCCESS);
+        }
+
+        if (parallel && (lazy || methods == uarray2_methods_compressed)) {
+                fprintf(stderr, "%s: -parallel cannot be combined with "
+                        "-lazy, -crop or -compressed\n", argv[0]);
+                exit(1);
         }
+        Numa_init(numa_sim);
+
         /* Reads in data into the Pnm_ppm obj */
+        Mem_phase_begin("read");
         Pnm_ppm pixmap = Pnm_ppmread(filename, methods);
-        double time_result = trans_ppm(pixmap, methods, map, rotation, 
-                time_included);
+        Mem_phase_end(ppm_bytes(pixmap) + raster_bytes(pixmap->width,
+                      pixmap->height));
+        double time_result;
         int num_pixels = pixmap->width * pixmap->height;
+
+        if (planar) {
+                /* -block-major picks blocked planes of 4KB blocks */
+                int blocksize = methods == uarray2_methods_blocked ? 64 : 1;
+                time_result = planar_ppm(pixmap, stdout, methods, blocksize,
+                        rotation, time_included, &convert_time);
+                Trace_note_str("planar_layout",
+                               blocksize == 1 ? "plain" : "blocked");
+                Trace_note_num("convert_ns", convert_time);
+        } else if (scheduled) {
+                time_result = sched_trans_ppm(pixmap, stdout, methods,
+                        rotation, prefetch > 0 ? prefetch : 0, serpentine,
+                        time_included, stats_fptr != NULL ? &stats : NULL);
+                struct Perf_counts counts;
+                Trace_note_num("prefetch_blocks", prefetch > 0 ? prefetch : 0);
+                Trace_note_num("serpentine", serpentine);
+                if (time_included && Perf_read(&counts)) {
+                        if (counts.cycles >= 0) {
+                                Trace_note_num("cycles", counts.cycles);
+                        }
+                        if (counts.l1d_misses >= 0) {
+                                Trace_note_num("l1d_read_misses",
+                                               counts.l1d_misses);
+                        }
+                        if (counts.llc_misses >= 0) {
+                                Trace_note_num("llc_misses",
+                                               counts.llc_misses);
+                        }
+                }
+        } else if (lazy) {
+                time_result = view_ppm(pixmap, stdout, methods, rotation,
+                        crop_included ? crop : NULL, time_included);
+                if (crop_included) {
+                        num_pixels = crop[2] * crop[3];
+                }
+        } else if (parallel) {
+                struct Numa_counts before, after;
+                bool counted = Numa_counts(&before);
+                time_result = par_trans_ppm(pixmap, stdout, methods,
+                        rotation, workers, numa_policy, time_included,
+                        stats_fptr != NULL ? &stats : NULL);
+                Trace_note_num("workers", workers);
+                Trace_note_num("numa_nodes", Numa_nodes());
+                Trace_note_num("numa_simulated", Numa_simulated());
+                /* The kernel counts pages allocated on or off their
+                 * intended node, the closest it gets to traffic; the
+                 * counters are machine-wide, so other processes show up
+                 * in them too */
+                if (counted && Numa_counts(&after)) {
+                        Trace_note_num("numa_system_local_pages",
+                                       after.local - before.local);
+                        Trace_note_num("numa_system_remote_pages",
+                                       after.remote - before.remote);
+                }
+        } else {
+                time_result = trans_ppm(pixmap, stdout, methods, map,
+                        rotation, time_included || autoplan,
+                        stats_fptr != NULL ? &stats : NULL);
+        }
+        if (autoplan && plan_fptr != NULL) {
+                Plan_log(plan_fptr, &plan, plan_width, plan_height, rotation,
+                         time_result);
+                fclose(plan_fptr);
+        }
         
-        /* Writes timing data to timing file */
-        if (time_included) {
-                fprintf(time_fptr, "Transformation: %d\n", rotation);
-                fprintf(time_fptr, "Number of Pixels %d\n", num_pixels);
-                fprintf(time_fptr, "Time taken to complete complete image" 
-                        "transformation: %.0f\n", time_result);
-                fprintf(time_fptr, "Time taken to complete transformation per" 
-                        "pixel: %.0f\n", time_result / num_pixels);
+        Trace_note_num("rotation", rotation);
+        Trace_note_num("pixels", num_pixels);
+        Trace_note_num("transform_ns", time_result);
+        Trace_note_num("ns_per_pixel", time_result / num_pixels);
+        Trace_note_num("mpixels_per_s",
+                       time_result > 0 ? num_pixels * 1e3 / time_result : 0);
+        /* Each pixel is read from the source and written to the result */
+        Trace_note_num("transform_bytes_per_s", time_result > 0 ?
+                       2 * raster_bytes(num_pixels, 1) * 1e9 / time_result :
+                       0);
+        if (autoplan) {
+                Trace_note_str("plan", plan.name);
+                char shape[32];
+                snprintf(shape, sizeof(shape), "%dx%d", plan.blk_width,
+                         plan.blk_height);
+                Trace_note_str("plan_blockshape", shape);
+                Trace_note_num("plan_predicted_ns", plan.predicted_ns);
+        }
+        /* Packed size next to what plain storage would take */
+        if (methods == uarray2_methods_compressed || blocked_suite(methods)) {
+                Trace_note_num("raster_bytes",
+                               UArray2b_footprint(pixmap->pixels));
+                Trace_note_num("raster_bytes_plain",
+                               (size_t) num_pixels * sizeof(struct Pnm_rgb));
+        }
+        if (stats_fptr != NULL) {
+                Stats_print(stats_fptr, &stats);
+                fclose(stats_fptr);
         }
         fclose(filename);
+        Mem_phase_begin("free");
+        Pnm_ppmfree(&pixmap);
+        Mem_phase_end(0);
+        free(image);
+
+        /* Written last so the final free is in the trace */
         if (time_included) {
+                Mem_note();
+                Trace_write_summary(time_fptr);
                 fclose(time_fptr);
         }
-        Pnm_ppmfree(&pixmap);
+        if (trace_fptr != NULL) {
+                Trace_write_chrome(trace_fptr);
+                fclose(trace_fptr);
+        }
 
         exit(EXIT_SUCCESS);
 }
 
-double trans_ppm(Pnm_ppm orig_img, A2Methods_T methods, A2Methods_mapfun map, 
-        int angle, bool time)
+double trans_ppm(Pnm_ppm orig_img, FILE *out, A2Methods_T methods,
+        A2Methods_mapfun map, int angle, bool time, struct Stats *stats)
 {
         struct closure *cl_trans = malloc(sizeof(struct closure));
         
         CPUTime_T clock = CPUTime_New();
         double elapsed_time = 0.0;
+        if (stats != NULL) {
+                Stats_init(stats);
+        }
 
+        /* Packed arrays rotate block by block so uniform blocks stay
+         * packed, and a blocked copy shares its blocks with the source;
+         * statistics need every cell visited, so they take the map */
+        bool shared = stats == NULL && blocked_suite(methods) && angle == 0;
+        Mem_phase_begin("rotate");
+        if (stats == NULL && (methods == uarray2_methods_compressed ||
+                              shared)) {
+                if (time) {
+                        CPUTime_Start(clock);
+                }
+                cl_trans->raster = UArray2b_rotate(orig_img->pixels, angle);
+                cl_trans->arrayfxns = methods;
+                if (time) {
+                        elapsed_time = CPUTime_Stop(clock);
+                }
+        }
         /* Does nothing, writes to stdout */
-        if (angle == 0) {
+        else if (angle == 0) {
                 cl_maker(orig_img->width, orig_img->height, cl_trans, methods);
                 /* Starts the timing of the rotation */
                 if (time) {
                         CPUTime_Start(clock);
                 }
-                (*map)(orig_img->pixels, (A2Methods_applyfun*) 
-                                rotate0, cl_trans);
+                map_rotation(map, orig_img,
+                        (A2Methods_applyfun *) rotate0, cl_trans, stats);
                 if (time) {
                         elapsed_time = CPUTime_Stop(clock);
                 }
         }
         /* Swaps height and width values */
-        if ((angle == 90) || (angle == 270)) {
+        else if ((angle == 90) || (angle == 270)) {
                 cl_maker(orig_img->height, orig_img->width, cl_trans, methods);
 
                 if (angle == 90) {
                         /* Starts the timing of the rotation */
                         if (time) {
                                 CPUTime_Start(clock);
-                                (*map)(orig_img->pixels, (A2Methods_applyfun*) 
-                                        rotate90, cl_trans);
+                                map_rotation(map, orig_img,
+                                        (A2Methods_applyfun *) rotate90,
+                                        cl_trans, stats);
                                 elapsed_time = CPUTime_Stop(clock);
                         }
                         /* In case time flag is not provided */
                         else {
-                                (*map)(orig_img->pixels, (A2Methods_applyfun*) 
-                                        rotate90, cl_trans);
+                                map_rotation(map, orig_img,
+                                        (A2Methods_applyfun *) rotate90,
+                                        cl_trans, stats);
                         }
                 }
                 if (angle == 270) {
                         /* Starts the timing of the rotation */
                         if (time) {
                                 CPUTime_Start(clock);
-                                (*map)(orig_img->pixels, (A2Methods_applyfun*) 
-                                        rotate270, cl_trans);
+                                map_rotation(map, orig_img,
+                                        (A2Methods_applyfun *) rotate270,
+                                        cl_trans, stats);
                                 elapsed_time = CPUTime_Stop(clock);
                         }       
                         /* In case time flag is not provided */
                         else {
-                                (*map)(orig_img->pixels, (A2Methods_applyfun*) 
-                                        rotate270, cl_trans);
+                                map_rotation(map, orig_img,
+                                        (A2Methods_applyfun *) rotate270,
+                                        cl_trans, stats);
                         }
                 }
         }
@@ -315,17 +991,22 @@ double trans_ppm(Pnm_ppm orig_img, A2Methods_T methods, A2Methods_mapfun map,
                 if (time) {
                         CPUTime_Start(clock);
                 }
-                (*map)(orig_img->pixels, (A2Methods_applyfun*) 
-                                rotate180, cl_trans);
+                map_rotation(map, orig_img,
+                        (A2Methods_applyfun *) rotate180, cl_trans, stats);
                 if (time) {
                         elapsed_time = CPUTime_Stop(clock);
                          }
         }
+        /* A shared copy moves no cells until one side writes */
+        Mem_phase_end(shared ? 0 : 2 * raster_bytes(orig_img->width,
+                                                     orig_img->height));
         
         /* Updates Pnm_ppm object with transformed values */
         orig_img->width = methods->width(cl_trans->raster);
         orig_img->height = methods->height(cl_trans->raster);
+        Mem_phase_begin("free");
         methods->free(&(orig_img->pixels));
+        Mem_phase_end(0);
         orig_img->pixels = cl_trans->raster;
 
         /* Frees passed in allocated objects (no longer needed) */
@@ -333,72 +1014,524 @@ double trans_ppm(Pnm_ppm orig_img, A2Methods_T methods, A2Methods_mapfun map,
         cl_trans = NULL;
         CPUTime_Free(&clock);
         
-        /* Writes to stdout */
-        Pnm_ppmwrite(stdout, orig_img);
+        /* Writes to the output file, reading rather than touching cells */
+        Mem_phase_begin("write");
+        write_ppm(out, orig_img);
+        Mem_phase_end(ppm_bytes(orig_img) +
+                      raster_bytes(orig_img->width, orig_img->height));
 
         return elapsed_time;
 }
 
-void cl_maker(int width, int height, struct closure *cl, A2Methods_T methods) {
-        A2Methods_UArray2 new_raster = methods->new(width, 
-                height, sizeof(struct Pnm_rgb));
-        cl->raster = new_raster;
-        cl->arrayfxns = methods;
+double view_ppm(Pnm_ppm orig_img, FILE *out, A2Methods_T methods, int angle,
+        const int *crop, bool time)
+{
+        CPUTime_T clock = CPUTime_New();
+        double elapsed_time = 0.0;
+
+        A2View_T rotated = A2View_transform(methods, orig_img->pixels,
+                Dihedral_from_angle(angle));
+        A2View_T view = rotated;
+        if (crop != NULL) {
+                A2Methods_T view_methods = uarray2_methods_view;
+                if (crop[0] + crop[2] > view_methods->width(rotated) ||
+                    crop[1] + crop[3] > view_methods->height(rotated)) {
+                        fprintf(stderr, "Crop does not fit in the rotated "
+                                        "image\n");
+                        exit(1);
+                }
+                view = A2View_crop(view_methods, rotated, crop[0], crop[1],
+                                   crop[2], crop[3]);
+        }
+
+        /* Pixmap that reads its cells through the view */
+        struct Pnm_ppm view_img = *orig_img;
+        view_img.pixels = view;
+        view_img.methods = uarray2_methods_view;
+        view_img.width = uarray2_methods_view->width(view);
+        view_img.height = uarray2_methods_view->height(view);
+
+        /* Writing is where the view's cells are finally visited */
+        if (time) {
+                CPUTime_Start(clock);
+        }
+        Mem_phase_begin("write");
+        write_ppm(out, &view_img);
+        Mem_phase_end(ppm_bytes(&view_img) +
+                      raster_bytes(view_img.width, view_img.height));
+        if (time) {
+                elapsed_time = CPUTime_Stop(clock);
+        }
+
+        if (view != rotated) {
+                A2View_free(&view);
+        }
+        A2View_free(&rotated);
+        CPUTime_Free(&clock);
+
+        return elapsed_time;
 }
 
-void rotate90(int col, int row, A2Methods_UArray2 arr, void *elem, 
-        void *cl_trans)
+int serve_image(const char *image, size_t length, FILE *out, int angle,
+        int layout)
 {
-        struct closure *new_cl_rotation = cl_trans;
+        A2Methods_T methods;
+        A2Methods_mapfun *map;
 
-        int height = new_cl_rotation->arrayfxns->height(arr);
+        switch (layout) {
+        case SERVE_ROW_MAJOR:
+                methods = uarray2_methods_plain;
+                map = methods->map_row_major;
+                break;
+        case SERVE_COL_MAJOR:
+                methods = uarray2_methods_plain;
+                map = methods->map_col_major;
+                break;
+        case SERVE_BLOCK_MAJOR:
+                methods = uarray2_methods_blocked;
+                map = methods->map_block_major;
+                break;
+        case SERVE_COMPRESSED:
+                methods = uarray2_methods_compressed;
+                map = methods->map_block_major;
+                break;
+        default:
+                return 1;
+        }
+        if (!(angle == 0 || angle == 90 || angle == 180 || angle == 270)) {
+                return 1;
+        }
+        if (!ppm_complete(image, length)) {
+                return 1;
+        }
 
-        struct Pnm_rgb pixel = (*(Pnm_rgb) elem);
-        
-        /* Reassigns pixel to new pos */
-        (*(Pnm_rgb) (new_cl_rotation->arrayfxns->at(new_cl_rotation->raster, 
-                     height - row - 1, col))) = pixel;
+        /* UArray2b_rotate allocates compressed rasters itself */
+        if (methods != uarray2_methods_compressed) {
+                methods = Pool_methods(methods);
+        }
+
+        FILE *in = fmemopen((void *) image, length, "rb");
+        assert(in != NULL);
+        Pnm_ppm pixmap = Pnm_ppmread(in, methods);
+        fclose(in);
+        trans_ppm(pixmap, out, methods, map, angle, false, NULL);
+        Pnm_ppmfree(&pixmap);
+
+        return 0;
 }
 
-void rotate180(int col, int row, A2Methods_UArray2 arr, void *elem, 
-        void *cl_trans)
+bool ppm_complete(const char *image, size_t length)
 {
-        struct closure *reflect = cl_trans;
+        /* Header is at most four numbers and some spaces */
+        char header[64];
+        size_t n = length < sizeof(header) - 1 ? length : sizeof(header) - 1;
+        memcpy(header, image, n);
+        header[n] = '\0';
 
-        int height = reflect->arrayfxns->height(arr);
-        
-        int width = reflect->arrayfxns->width(arr);
-        
-        struct Pnm_rgb pixel = (*(Pnm_rgb) elem);
-        
-        /* Reassigns pixel to new pos */
-        (*(Pnm_rgb) (reflect->arrayfxns->at(reflect->raster, width - col - 1, 
-                     height - row - 1))) = pixel;
+        unsigned width, height, maxval;
+        int end = 0;
+        if (sscanf(header, "P6 %u %u %u%n", &width, &height, &maxval,
+                   &end) != 3 || end == 0 || (size_t) end >= n) {
+                return false;
+        }
+        if (width == 0 || height == 0 || maxval == 0 || maxval > 65535) {
+                return false;
+        }
+        /* One whitespace character separates header and raster */
+        size_t bytes = (size_t) width * height * 3 * (maxval < 256 ? 1 : 2);
+        return length - (end + 1) >= bytes;
+}
+
+double planar_ppm(Pnm_ppm orig_img, FILE *out, A2Methods_T methods,
+        int blocksize, int angle, bool time, double *convert)
+{
+        CPUTime_T clock = CPUTime_New();
+        double elapsed_time = 0.0;
+        *convert = 0.0;
+
+        assert(orig_img->denominator <= 65535);
+        Planar_T planes = Planar_new(orig_img->width, orig_img->height,
+                                     blocksize);
+        if (time) {
+                CPUTime_Start(clock);
+        }
+        Mem_phase_begin("split");
+        Planar_deinterleave(planes, methods, orig_img->pixels);
+        Mem_phase_end(raster_bytes(orig_img->width, orig_img->height) +
+                      planes_bytes(orig_img->width, orig_img->height));
+        if (time) {
+                *convert += CPUTime_Stop(clock);
+                CPUTime_Start(clock);
+        }
+        Mem_phase_begin("rotate");
+        Planar_T rotated = Planar_rotate(planes, angle);
+        Mem_phase_end(2 * planes_bytes(orig_img->width, orig_img->height));
+        if (time) {
+                elapsed_time = CPUTime_Stop(clock);
+                CPUTime_Start(clock);
+        }
+        Mem_phase_begin("write");
+        Planar_write(out, rotated, orig_img->denominator);
+        Mem_phase_end(planes_bytes(orig_img->width, orig_img->height) +
+                      ppm_bytes(orig_img));
+        if (time) {
+                *convert += CPUTime_Stop(clock);
+        }
+
+        Mem_phase_begin("free");
+        Planar_free(&planes);
+        Planar_free(&rotated);
+        Mem_phase_end(0);
+        CPUTime_Free(&clock);
+        return elapsed_time;
 }
 
-void rotate270(int col, int row, A2Methods_UArray2 arr, void *elem, 
-        void *cl_trans)
+char *read_stream(FILE *fp, size_t *length)
 {
-        struct closure *new_cl_rotation = cl_trans;
+        size_t capacity = 1 << 16;
+        char *bytes = malloc(capacity);
+        assert(bytes != NULL);
+        *length = 0;
 
-        int width = new_cl_rotation->arrayfxns->width(arr);
+        size_t got;
+        while ((got = fread(bytes + *length, 1, capacity - *length, fp))
+               > 0) {
+                *length += got;
+                if (*length == capacity) {
+                        capacity *= 2;
+                        bytes = realloc(bytes, capacity);
+                        assert(bytes != NULL);
+                }
+        }
+        return bytes;
+}
 
-        struct Pnm_rgb pixel = (*(Pnm_rgb) elem);
-        
-        /* Reassigns pixel to new pos */
-        (*(Pnm_rgb) (new_cl_rotation->arrayfxns->at(new_cl_rotation->raster, 
-                     row, width - col - 1))) = pixel;
+/**********alloc_blocks********
+ * Parallel_run work: allocates (and so first touches) a run of blocks
+ ************************/
+static void alloc_blocks(int thread, int first, int last, void *cl)
+{
+        (void) thread;
+        UArray2b_alloc_range(cl, first, last);
 }
 
-void rotate0(int col, int row, A2Methods_UArray2 arr, void *elem, 
-        void *cl_trans)
+/**********touch_rows********
+ * Parallel_run work: first touches a run of rows of a plain raster
+ ************************/
+static void touch_rows(int thread, int first, int last, void *cl)
 {
-        (void) arr;
-        struct closure *new_cl_rotation = cl_trans;
+        struct closure *trans = cl;
+        int width = trans->arrayfxns->width(trans->raster);
+        int size = trans->arrayfxns->size(trans->raster);
+        (void) thread;
 
-        struct Pnm_rgb pixel = (*(Pnm_rgb) elem);
-        
-        /* Reassigns pixel to new pos */
-        (*(Pnm_rgb) (new_cl_rotation->arrayfxns->at(new_cl_rotation->raster, 
-                     col, row))) = pixel;
+        for (int row = first; row < last; row++) {
+                for (int col = 0; col < width; col++) {
+                        memset(trans->arrayfxns->at(trans->raster, col, row),
+                               0, size);
+                }
+        }
+}
+
+/**********place_block********
+ * UArray2b_place callback: binds or interleaves one block's pages
+ ************************/
+static void place_block(void *mem, size_t bytes, int part, void *cl)
+{
+        struct placement *how = cl;
+        Numa_place(mem, bytes, Numa_node_of(part, how->nthreads),
+                   how->policy);
+}
+
+/**********source_owner********
+ * UArray2b_place_owned owner: the thread whose run of destination
+ * blocks, as Parallel_run splits them, holds the cell (col, row) of the
+ * source rotates onto
+ ************************/
+static int source_owner(int col, int row, void *cl)
+{
+        struct source_placement *src = cl;
+        int dcol, drow;
+        Dihedral_point(src->op, src->width, src->height, col, row, &dcol,
+                       &drow);
+        int bw = UArray2b_block_width(src->dest);
+        int bh = UArray2b_block_height(src->dest);
+        int blkwidth = (UArray2b_width(src->dest) + bw - 1) / bw;
+        long k = (long) (drow / bh) * blkwidth + dcol / bw;
+        int nblocks = UArray2b_nblocks(src->dest);
+        return ((k + 1) * src->how.nthreads - 1) / nblocks;
+}
+
+/**********place_source_block********
+ * UArray2b_place_owned callback: places a source block like the
+ * destination blocks of the thread that reads it
+ ************************/
+static void place_source_block(void *mem, size_t bytes, int part, void *cl)
+{
+        struct source_placement *src = cl;
+        place_block(mem, bytes, part, &src->how);
+}
+
+/**********pull_cell********
+ * Fills one destination cell from the source cell that rotates onto it,
+ * folding that source pixel into the thread's statistics if it keeps any
+ ************************/
+static void pull_cell(int col, int row, A2Methods_UArray2 dest, void *elem,
+                      void *cl)
+{
+        struct fused *fused = cl;
+        struct par_closure *par = fused->par;
+        int scol, srow;
+        (void) dest;
+
+        Dihedral_point(par->inverse, par->width, par->height, col, row,
+                       &scol, &srow);
+        const struct Pnm_rgb *pixel = par->methods->get(par->source, scol,
+                                                        srow);
+        if (fused->partial != NULL) {
+                Stats_accumulate(scol, srow, (void *) pixel, fused->partial,
+                                 &par->denominator);
+        }
+        *(struct Pnm_rgb *) elem = *pixel;
+}
+
+/**********turned_blocks********
+ * Makes the destination of a blocked rotation: width x height cells in
+ * blocks of the source's shape, turned with the image when the angle
+ * swaps dimensions so each source block lands on as few blocks as
+ * possible
+ ************************/
+static UArray2b_T turned_blocks(UArray2b_T source, int width, int height,
+                                int angle)
+{
+        int blk_width = UArray2b_block_width(source);
+        int blk_height = UArray2b_block_height(source);
+        if (angle == 90 || angle == 270) {
+                blk_width = UArray2b_block_height(source);
+                blk_height = UArray2b_block_width(source);
+        }
+        return UArray2b_new_rect(width, height, sizeof(struct Pnm_rgb),
+                                 blk_width, blk_height);
+}
+
+/**********rotate_blocks********
+ * Parallel_run work: fills a run of destination blocks, the same run
+ * alloc_blocks first touched and UArray2b_place placed for this thread
+ ************************/
+static void rotate_blocks(int thread, int first, int last, void *cl)
+{
+        struct par_closure *par = cl;
+        struct fused fused = { par, NULL };
+        if (par->partials != NULL) {
+                fused.partial = &par->partials[thread];
+        }
+        UArray2b_map_range(par->dest, first, last,
+                           (void (*)(int, int, UArray2b_T, void *, void *))
+                           pull_cell, &fused);
+}
+
+/**********prefetch_dest********
+ * UArray2b_schedule lookahead: prefetches, for writing, the destination
+ * cells a rectangle of the source rotates onto
+ ************************/
+static void prefetch_dest(int col, int row, int width, int height, void *cl)
+{
+        struct lookahead *look = cl;
+        Dihedral_rect(look->op, look->width, look->height, &col, &row,
+                      &width, &height);
+        UArray2b_prefetch(look->dest, col, row, width, height, 1);
+}
+
+/**********rotate_rows********
+ * Parallel_run work: fills a run of destination rows, the same run
+ * touch_rows first touched for this thread
+ ************************/
+static void rotate_rows(int thread, int first, int last, void *cl)
+{
+        struct par_closure *par = cl;
+        struct fused fused = { par, NULL };
+        if (par->partials != NULL) {
+                fused.partial = &par->partials[thread];
+        }
+
+        for (int row = first; row < last; row++) {
+                for (int col = 0; col < par->width; col++) {
+                        pull_cell(col, row, par->dest,
+                                  par->methods->at(par->dest, col, row),
+                                  &fused);
+                }
+        }
+}
+
+double par_trans_ppm(Pnm_ppm orig_img, FILE *out, A2Methods_T methods,
+        int angle, int nthreads, int policy, bool time, struct Stats *stats)
+{
+        assert(methods != uarray2_methods_compressed);
+        bool blocked = blocked_suite(methods);
+        struct closure trans = { NULL, methods };
+        Dihedral_T inverse = Dihedral_inverse(Dihedral_from_angle(angle));
+        struct par_closure par = { orig_img->pixels, NULL, methods, inverse,
+                                   0, 0, NULL, orig_img->denominator };
+        struct placement how = { policy, nthreads };
+
+        if (stats != NULL) {
+                par.partials = malloc(nthreads * sizeof(struct Stats));
+                assert(par.partials != NULL);
+                for (int t = 0; t < nthreads; t++) {
+                        Stats_init(&par.partials[t]);
+                }
+        }
+
+        CPUTime_T clock = CPUTime_New();
+        double elapsed_time = 0.0;
+
+        int width = orig_img->width, height = orig_img->height;
+        if (angle == 90 || angle == 270) {
+                width = orig_img->height;
+                height = orig_img->width;
+        }
+        par.width = width;
+        par.height = height;
+
+        /* Each thread allocates or touches the part of the destination it
+         * will fill, and the source blocks it reads follow it under the
+         * same policy; a plain source is one allocation the reader
+         * already touched, so it stays wherever it lies */
+        Mem_phase_begin("first-touch");
+        if (blocked) {
+                trans.raster = turned_blocks(orig_img->pixels, width, height,
+                                             angle);
+                Parallel_run(nthreads, UArray2b_nblocks(trans.raster),
+                             alloc_blocks, trans.raster);
+                UArray2b_place(trans.raster, nthreads, place_block, &how);
+                struct source_placement src = {
+                        how, trans.raster, Dihedral_from_angle(angle),
+                        orig_img->width, orig_img->height
+                };
+                UArray2b_place_owned(orig_img->pixels, source_owner,
+                                     place_source_block, &src);
+        } else {
+                cl_maker(width, height, &trans, methods);
+                Parallel_run(nthreads, height, touch_rows, &trans);
+        }
+        Mem_phase_end(raster_bytes(width, height));
+        par.dest = trans.raster;
+
+        if (time) {
+                CPUTime_Start(clock);
+        }
+        Mem_phase_begin("rotate");
+        if (blocked) {
+                Parallel_run(nthreads, UArray2b_nblocks(trans.raster),
+                             rotate_blocks, &par);
+        } else {
+                Parallel_run(nthreads, height, rotate_rows, &par);
+        }
+        Mem_phase_end(2 * raster_bytes(width, height));
+        if (time) {
+                elapsed_time = CPUTime_Stop(clock);
+        }
+        if (stats != NULL) {
+                Stats_init(stats);
+                for (int t = 0; t < nthreads; t++) {
+                        Stats_merge(stats, &par.partials[t], NULL);
+                }
+                free(par.partials);
+        }
+
+        /* Updates Pnm_ppm object with transformed values */
+        orig_img->width = width;
+        orig_img->height = height;
+        Mem_phase_begin("free");
+        methods->free(&(orig_img->pixels));
+        Mem_phase_end(0);
+        orig_img->pixels = trans.raster;
+        CPUTime_Free(&clock);
+
+        Mem_phase_begin("write");
+        Pnm_ppmwrite(out, orig_img);
+        Mem_phase_end(ppm_bytes(orig_img) + raster_bytes(width, height));
+
+        return elapsed_time;
+}
+
+double sched_trans_ppm(Pnm_ppm orig_img, FILE *out, A2Methods_T methods,
+        int angle, int distance, bool serpentine, bool time,
+        struct Stats *stats)
+{
+        assert(methods == uarray2_methods_blocked);
+        struct closure trans = { NULL, methods };
+        A2Methods_applyfun *apply;
+
+        CPUTime_T clock = CPUTime_New();
+        double elapsed_time = 0.0;
+
+        switch (angle) {
+        case 0:   apply = (A2Methods_applyfun *) rotate0;   break;
+        case 90:  apply = (A2Methods_applyfun *) rotate90;  break;
+        case 180: apply = (A2Methods_applyfun *) rotate180; break;
+        default:  apply = (A2Methods_applyfun *) rotate270; break;
+        }
+        int width = orig_img->width, height = orig_img->height;
+        if (angle == 90 || angle == 270) {
+                width = orig_img->height;
+                height = orig_img->width;
+        }
+        Mem_phase_begin("alloc");
+        trans.raster = turned_blocks(orig_img->pixels, width, height, angle);
+        Mem_phase_end(0);
+
+        struct lookahead look = { trans.raster, Dihedral_from_angle(angle),
+                                  orig_img->width, orig_img->height };
+        struct UArray2b_schedule schedule = {
+                distance, serpentine, distance > 0 ? prefetch_dest : NULL,
+                &look
+        };
+
+        if (time) {
+                CPUTime_Start(clock);
+                Perf_start();
+        }
+        struct counted counted = { &trans, apply, stats,
+                                   orig_img->denominator };
+        void *cl = &trans;
+        if (stats != NULL) {
+                Stats_init(stats);
+                apply = (A2Methods_applyfun *) rotate_counted;
+                cl = &counted;
+        }
+        Mem_phase_begin("rotate");
+        UArray2b_map_scheduled(orig_img->pixels, &schedule,
+                               (void (*)(int, int, UArray2b_T, void *,
+                                         void *)) apply, cl);
+        Mem_phase_end(2 * raster_bytes(width, height));
+        if (time) {
+                Perf_stop();
+                elapsed_time = CPUTime_Stop(clock);
+        }
+
+        /* Updates Pnm_ppm object with transformed values */
+        orig_img->width = width;
+        orig_img->height = height;
+        Mem_phase_begin("free");
+        methods->free(&(orig_img->pixels));
+        Mem_phase_end(0);
+        orig_img->pixels = trans.raster;
+        CPUTime_Free(&clock);
+
+        Mem_phase_begin("write");
+        Pnm_ppmwrite(out, orig_img);
+        Mem_phase_end(ppm_bytes(orig_img) + raster_bytes(width, height));
+
+        return elapsed_time;
+}
+
+void cl_maker(int width, int height, struct closure *cl, A2Methods_T methods) {
+        Mem_phase_begin("alloc");
+        A2Methods_UArray2 new_raster = methods->new(width, 
+                height, sizeof(struct Pnm_rgb));
+        Mem_count(MEM_CL_MAKER, raster_bytes(width, height));
+        Mem_phase_end(0);
+        cl->raster = new_raster;
+        cl->arrayfxns = methods;
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+/**************************************************************
+ *                     rasterpool.c
+ *
+ *     implementation of the raster pool. A2Methods_T functions take
+ *     no closure, so the suite being wrapped and the pool itself are
+ *     thread-local.
+ *
+ **************************************************************/
+
+#include <stddef.h>
+
+#include "assert.h"
+#include "rasterpool.h"
+#include "uarray2b.h"
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+/* Most rasters a thread keeps */
+#define POOL_LEN 4
+
+struct pooled {
+        A2Methods_T methods;    /* suite that made the raster */
+        int width, height, size;
+        A2 raster;
+};
+
+static __thread struct pooled pool[POOL_LEN];
+static __thread int npooled;
+static __thread A2Methods_T under;              /* suite being wrapped */
+static __thread struct A2Methods_T wrapper;
+
+static A2 pool_new(int width, int height, int size);
+static void pool_free(A2 *array2p);
+
+/**********Pool_methods********
+ * Wraps a methods suite so its rasters are recycled by this thread
+ * Inputs: A2Methods_T methods: the suite to wrap
+ * Return: the wrapping suite
+ * Expects: methods non NULL
+ ************************/
+A2Methods_T Pool_methods(A2Methods_T methods)
+{
+        assert(methods != NULL);
+        under = methods;
+        wrapper = *methods;
+        wrapper.new = pool_new;
+        wrapper.free = pool_free;
+        return &wrapper;
+}
+
+/**********pool_new********
+ * Hands back a pooled raster of the same suite and shape, or makes one
+ ************************/
+static A2 pool_new(int width, int height, int size)
+{
+        for (int i = 0; i < npooled; i++) {
+                struct pooled *p = &pool[i];
+                if (p->methods == under && p->width == width &&
+                    p->height == height && p->size == size) {
+                        A2 raster = p->raster;
+                        pool[i] = pool[--npooled];
+                        return raster;
+                }
+        }
+        return under->new(width, height, size);
+}
+
+/**********pool_free********
+ * Keeps a raster for reuse, or frees it when the pool is full or, for
+ * blocked suites, when a block is still shared with a copy: a recycled
+ * raster is written in place, and its new owner must not have to rely
+ * on copy-on-write to leave the copy alone
+ ************************/
+static void pool_free(A2 *array2p)
+{
+        assert(array2p != NULL && *array2p != NULL);
+        int blocked = under->map_block_major != NULL;
+        if (npooled == POOL_LEN ||
+            (blocked && UArray2b_shared(*array2p))) {
+                under->free(array2p);
+                return;
+        }
+        struct pooled *p = &pool[npooled++];
+        p->methods = under;
+        p->width = under->width(*array2p);
+        p->height = under->height(*array2p);
+        p->size = under->size(*array2p);
+        p->raster = *array2p;
+        *array2p = NULL;
+}
@@ -0,0 +1,23 @@
+/**************************************************************
+ *                     rasterpool.h
+ *
+ *     interface for a per-thread pool of freed rasters. Wrapping a
+ *     methods suite makes its free keep a few rasters around and its
+ *     new hand back a kept raster of the same shape, so a long-running
+ *     thread stops paying for allocation and first-touch page faults.
+ *
+ **************************************************************/
+#ifndef RASTERPOOL_INCLUDED
+#define RASTERPOOL_INCLUDED
+
+#include "a2methods.h"
+
+/* Returns a suite that behaves like methods except for new and free.
+ * The suite belongs to the calling thread and is only valid there,
+ * until the next call to Pool_methods on that thread.
+ * Rasters handed out again are NOT cleared. A blocked raster freed
+ * while a copy still shares its blocks is freed, not kept.
+ */
+extern A2Methods_T Pool_methods(A2Methods_T methods);
+
+#endif
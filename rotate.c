@@ -0,0 +1,69 @@
+/**************************************************************
+ *                     rotate.c
+ *     Assignment: HW3 locality
+ *     Authors:  Arjun Kantamsetty (akanta01) and Vir Bhatia (vbhati02)
+ *     Date:     February 23, 2023
+ *
+ *     implementation of the reference rotation apply functions, moved
+ *     here from ppmtrans.c so a2test can check every path against them
+ *
+ **************************************************************/
+#include "rotate.h"
+#include "pnm.h"
+
+void rotate90(int col, int row, A2Methods_UArray2 arr, void *elem, 
+        void *cl_trans)
+{
+        struct closure *new_cl_rotation = cl_trans;
+
+        int height = new_cl_rotation->arrayfxns->height(arr);
+
+        struct Pnm_rgb pixel = (*(Pnm_rgb) elem);
+        
+        /* Reassigns pixel to new pos */
+        (*(Pnm_rgb) (new_cl_rotation->arrayfxns->at(new_cl_rotation->raster, 
+                     height - row - 1, col))) = pixel;
+}
+
+void rotate180(int col, int row, A2Methods_UArray2 arr, void *elem, 
+        void *cl_trans)
+{
+        struct closure *reflect = cl_trans;
+
+        int height = reflect->arrayfxns->height(arr);
+        
+        int width = reflect->arrayfxns->width(arr);
+        
+        struct Pnm_rgb pixel = (*(Pnm_rgb) elem);
+        
+        /* Reassigns pixel to new pos */
+        (*(Pnm_rgb) (reflect->arrayfxns->at(reflect->raster, width - col - 1, 
+                     height - row - 1))) = pixel;
+}
+
+void rotate270(int col, int row, A2Methods_UArray2 arr, void *elem, 
+        void *cl_trans)
+{
+        struct closure *new_cl_rotation = cl_trans;
+
+        int width = new_cl_rotation->arrayfxns->width(arr);
+
+        struct Pnm_rgb pixel = (*(Pnm_rgb) elem);
+        
+        /* Reassigns pixel to new pos */
+        (*(Pnm_rgb) (new_cl_rotation->arrayfxns->at(new_cl_rotation->raster, 
+                     row, width - col - 1))) = pixel;
+}
+
+void rotate0(int col, int row, A2Methods_UArray2 arr, void *elem, 
+        void *cl_trans)
+{
+        (void) arr;
+        struct closure *new_cl_rotation = cl_trans;
+
+        struct Pnm_rgb pixel = (*(Pnm_rgb) elem);
+        
+        /* Reassigns pixel to new pos */
+        (*(Pnm_rgb) (new_cl_rotation->arrayfxns->at(new_cl_rotation->raster, 
+                     col, row))) = pixel;
+}
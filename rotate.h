@@ -0,0 +1,101 @@
+/**************************************************************
+ *                     rotate.h
+ *
+ *     interface for the reference rotation apply functions: mapped over
+ *     a raster of struct Pnm_rgb, each copies every pixel to its rotated
+ *     place in the closure's raster. ppmtrans rotates with them, and
+ *     a2test checks every other path against them.
+ *
+ **************************************************************/
+#ifndef ROTATE_INCLUDED
+#define ROTATE_INCLUDED
+
+#include "a2methods.h"
+
+/* The destination raster; arrayfxns is the suite of both rasters */
+struct closure {
+        A2Methods_UArray2 raster;
+        A2Methods_T arrayfxns;
+};
+
+/**********rotate90********
+ *
+ * apply function to do 90 degree image rotation
+ * Inputs:
+ *              int col: column index of a cell
+ *              int row: row index of a cell
+ *              A2Methods_UArray2 arr: UArray2b object which will hold the
+                                       updated image raster
+                void *elem: A pointer to the element at index (col, row)
+                void *cl_trans: pointer to the closure struct
+                
+ * Return:      n/a
+ * Expects:
+ *              more than 1 command line argument to be supplied
+ * Notes:
+ *              assert exists to check if insufficient args are inputted
+************************/
+void rotate90(int col, int row, A2Methods_UArray2 arr, void *elem, 
+        void *cl_trans);
+
+/**********rotate180********
+ *
+ * apply function to do 180 degree image rotation
+ * Inputs:
+ *              int col: column index of a cell
+ *              int row: row index of a cell
+ *              A2Methods_UArray2 arr: UArray2b object which will hold the
+                                       updated image raster
+                void *elem: A pointer to the element at index (col, row)
+                void *cl_trans: pointer to the closure struct
+                
+ * Return:      n/a
+ * Expects:
+ *              more than 1 command line argument to be supplied
+ * Notes:
+ *              assert exists to check if insufficient args are inputted
+************************/
+void rotate180(int col, int row, A2Methods_UArray2 arr, void *elem, 
+        void *cl_trans);
+
+/**********rotate270********
+ *
+ * apply function to do 270 degree image rotation
+ * Inputs:
+ *              int col: column index of a cell
+ *              int row: row index of a cell
+ *              A2Methods_UArray2 arr: UArray2b object which will hold the
+                                       updated image raster
+                void *elem: A pointer to the element at index (col, row)
+                void *cl_trans: pointer to the closure struct
+                
+ * Return:      n/a
+ * Expects:
+ *              more than 1 command line argument to be supplied
+ * Notes:
+ *              assert exists to check if insufficient args are inputted
+************************/
+void rotate270(int col, int row, A2Methods_UArray2 arr, void *elem, 
+        void *cl_trans);
+
+/**********rotate0********
+ *
+ * apply function to do 0 degree image rotation
+ * Inputs:
+ *              int col: column index of a cell
+ *              int row: row index of a cell
+ *              A2Methods_UArray2 arr: UArray2b object which will hold the
+                                       updated image raster
+                void *elem: A pointer to the element at index (col, row)
+                void *cl_trans: pointer to the closure struct
+                
+ * Return:      n/a
+ * Expects:
+ *              more than 1 command line argument to be supplied
+ * Notes:
+ *              assert exists to check if insufficient args are inputted
+************************/
+void rotate0(int col, int row, A2Methods_UArray2 arr, void *elem, 
+        void *cl_trans);
+
+#endif
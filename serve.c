@@ -0,0 +1,316 @@
+/**************************************************************
+ *                     serve.c
+ *
+ *     implementation of the transform daemon. A fixed pool of worker
+ *     threads blocks in accept() on one listening socket; each worker
+ *     serves one connection at a time, answering its requests in
+ *     order. Latencies of recent requests are kept in a ring so a
+ *     stats request can report percentiles.
+ *
+ **************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "assert.h"
+#include "serve.h"
+
+/* Number of recent latencies kept for percentiles */
+#define LATENCY_RING 4096
+
+static struct {
+        pthread_mutex_t lock;
+        unsigned long requests;
+        unsigned long errors;
+        unsigned long long bytes_in;
+        unsigned long long bytes_out;
+        double latency_us[LATENCY_RING];
+        unsigned long recorded;
+} stats = { PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, 0, { 0 }, 0 };
+
+struct worker {
+        pthread_t thread;
+        int listen_fd;
+        Serve_handler *handler;
+};
+
+static void *worker_main(void *vworker);
+static void serve_connection(int fd, Serve_handler *handler);
+static int send_reply(int fd, uint32_t status, const void *body,
+                      size_t length);
+static size_t stats_report(char **text);
+static void stats_record(double latency_us, size_t in, size_t out, int ok);
+static double now_us(void);
+static int compare_doubles(const void *a, const void *b);
+
+/**********Serve_run********
+ * Binds a Unix domain socket and serves transform requests on it
+ * Inputs:
+ *              const char *path: filesystem path of the socket; any file
+ *                                already there is removed
+ *              int nworkers: number of worker threads kept warm
+ *              Serve_handler *handler: transforms one image
+ * Return: nonzero if the socket could not be created, otherwise does not
+ *         return
+ * Expects: path fits in sockaddr_un, nworkers positive
+ ************************/
+int Serve_run(const char *path, int nworkers, Serve_handler *handler)
+{
+        assert(path != NULL && handler != NULL && nworkers > 0);
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr.sun_path)) {
+                fprintf(stderr, "Socket path too long: %s\n", path);
+                return 1;
+        }
+        strcpy(addr.sun_path, path);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+                perror("socket");
+                return 1;
+        }
+        unlink(path);
+        if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+            listen(fd, 64) < 0) {
+                perror(path);
+                close(fd);
+                return 1;
+        }
+        /* A client hanging up must not kill the daemon */
+        signal(SIGPIPE, SIG_IGN);
+
+        struct worker *workers = malloc(nworkers * sizeof(*workers));
+        assert(workers != NULL);
+        for (int i = 0; i < nworkers; i++) {
+                workers[i].listen_fd = fd;
+                workers[i].handler = handler;
+                int rc = pthread_create(&workers[i].thread, NULL,
+                                        worker_main, &workers[i]);
+                assert(rc == 0);
+        }
+        for (int i = 0; i < nworkers; i++) {
+                pthread_join(workers[i].thread, NULL);
+        }
+        free(workers);
+        close(fd);
+        return 0;
+}
+
+/**********Serve_read_all********
+ * Reads exactly len bytes from fd, retrying short reads
+ * Return: 0 on success, -1 on error or end of file
+ ************************/
+int Serve_read_all(int fd, void *buf, size_t len)
+{
+        char *p = buf;
+        while (len > 0) {
+                ssize_t n = read(fd, p, len);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n <= 0) {
+                        return -1;
+                }
+                p += n;
+                len -= n;
+        }
+        return 0;
+}
+
+/**********Serve_write_all********
+ * Writes exactly len bytes to fd, retrying short writes
+ * Return: 0 on success, -1 on error
+ ************************/
+int Serve_write_all(int fd, const void *buf, size_t len)
+{
+        const char *p = buf;
+        while (len > 0) {
+                ssize_t n = write(fd, p, len);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n <= 0) {
+                        return -1;
+                }
+                p += n;
+                len -= n;
+        }
+        return 0;
+}
+
+/**********worker_main********
+ * Body of a worker thread: accepts connections forever
+ ************************/
+static void *worker_main(void *vworker)
+{
+        struct worker *worker = vworker;
+        for (;;) {
+                int fd = accept(worker->listen_fd, NULL, NULL);
+                if (fd < 0) {
+                        if (errno == EINTR || errno == ECONNABORTED) {
+                                continue;
+                        }
+                        perror("accept");
+                        return NULL;
+                }
+                serve_connection(fd, worker->handler);
+                close(fd);
+        }
+}
+
+/**********serve_connection********
+ * Answers requests on one connection, in order, until the client hangs
+ * up or sends something malformed
+ ************************/
+static void serve_connection(int fd, Serve_handler *handler)
+{
+        struct Serve_header header;
+        char *image = NULL;
+        size_t capacity = 0;
+
+        while (Serve_read_all(fd, &header, sizeof(header)) == 0) {
+                if (header.magic != SERVE_MAGIC ||
+                    header.length > SERVE_MAX_LENGTH) {
+                        send_reply(fd, 1, NULL, 0);
+                        break;
+                }
+                /* The request buffer is reused across requests */
+                if (header.length > capacity) {
+                        free(image);
+                        capacity = header.length;
+                        image = malloc(capacity);
+                        assert(image != NULL);
+                }
+                if (Serve_read_all(fd, image, header.length) != 0) {
+                        break;
+                }
+
+                if (header.type == SERVE_STATS) {
+                        char *text;
+                        size_t length = stats_report(&text);
+                        int rc = send_reply(fd, 0, text, length);
+                        free(text);
+                        if (rc != 0) {
+                                break;
+                        }
+                        continue;
+                }
+
+                double start = now_us();
+                char *result = NULL;
+                size_t length = 0;
+                int status = 1;
+                if (header.type == SERVE_TRANSFORM) {
+                        FILE *out = open_memstream(&result, &length);
+                        assert(out != NULL);
+                        status = handler(image, header.length, out,
+                                         header.angle, header.layout);
+                        fclose(out);
+                }
+                if (status != 0) {
+                        length = 0;
+                }
+                int rc = send_reply(fd, status, result, length);
+                stats_record(now_us() - start, header.length, length,
+                             status == 0);
+                free(result);
+                if (rc != 0) {
+                        break;
+                }
+        }
+        free(image);
+}
+
+/**********send_reply********
+ * Writes a reply header and its body
+ * Return: 0 on success, -1 if the client went away
+ ************************/
+static int send_reply(int fd, uint32_t status, const void *body,
+                      size_t length)
+{
+        struct Serve_reply reply = { status, length };
+        if (Serve_write_all(fd, &reply, sizeof(reply)) != 0) {
+                return -1;
+        }
+        return length == 0 ? 0 : Serve_write_all(fd, body, length);
+}
+
+/**********stats_record********
+ * Adds one finished request to the running statistics
+ ************************/
+static void stats_record(double latency_us, size_t in, size_t out, int ok)
+{
+        pthread_mutex_lock(&stats.lock);
+        stats.requests++;
+        if (!ok) {
+                stats.errors++;
+        }
+        stats.bytes_in += in;
+        stats.bytes_out += out;
+        stats.latency_us[stats.recorded % LATENCY_RING] = latency_us;
+        stats.recorded++;
+        pthread_mutex_unlock(&stats.lock);
+}
+
+/**********stats_report********
+ * Formats the statistics as "key value" lines
+ * Inputs: char **text: set to a malloc'd, unterminated report
+ * Return: length of the report
+ ************************/
+static size_t stats_report(char **text)
+{
+        double sorted[LATENCY_RING];
+
+        pthread_mutex_lock(&stats.lock);
+        int n = stats.recorded < LATENCY_RING ? stats.recorded : LATENCY_RING;
+        memcpy(sorted, stats.latency_us, n * sizeof(double));
+        unsigned long requests = stats.requests;
+        unsigned long errors = stats.errors;
+        unsigned long long bytes_in = stats.bytes_in;
+        unsigned long long bytes_out = stats.bytes_out;
+        pthread_mutex_unlock(&stats.lock);
+
+        qsort(sorted, n, sizeof(double), compare_doubles);
+        double p50 = n ? sorted[(n - 1) * 50 / 100] : 0;
+        double p90 = n ? sorted[(n - 1) * 90 / 100] : 0;
+        double p99 = n ? sorted[(n - 1) * 99 / 100] : 0;
+        double max = n ? sorted[n - 1] : 0;
+
+        size_t length;
+        FILE *out = open_memstream(text, &length);
+        assert(out != NULL);
+        fprintf(out, "requests %lu\nerrors %lu\nbytes_in %llu\n"
+                     "bytes_out %llu\nlatency_p50_us %.1f\n"
+                     "latency_p90_us %.1f\nlatency_p99_us %.1f\n"
+                     "latency_max_us %.1f\n",
+                requests, errors, bytes_in, bytes_out, p50, p90, p99, max);
+        fclose(out);
+        return length;
+}
+
+/**********now_us********
+ * Returns a monotonic timestamp in microseconds
+ ************************/
+static double now_us(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+        double x = *(const double *) a;
+        double y = *(const double *) b;
+        return (x > y) - (x < y);
+}
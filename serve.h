@@ -0,0 +1,56 @@
+/**************************************************************
+ *                     serve.h
+ *
+ *     interface for the transform daemon: the wire format spoken over
+ *     the Unix domain socket and the server loop. Every request is a
+ *     Serve_header followed by header.length bytes of image; every
+ *     reply is a Serve_reply followed by reply.length bytes. Fields are
+ *     in host byte order since both ends share a machine. A client may
+ *     send any number of requests before reading replies, which come
+ *     back in request order.
+ *
+ **************************************************************/
+#ifndef SERVE_INCLUDED
+#define SERVE_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SERVE_MAGIC 0x4c4f4331u         /* "LOC1" */
+#define SERVE_MAX_LENGTH (1u << 30)     /* largest image accepted */
+
+/* Request types */
+enum { SERVE_TRANSFORM = 1, SERVE_STATS };
+
+/* Raster layouts a request can ask for */
+enum { SERVE_ROW_MAJOR = 0, SERVE_COL_MAJOR, SERVE_BLOCK_MAJOR,
+       SERVE_COMPRESSED };
+
+struct Serve_header {
+        uint32_t magic;
+        uint32_t type;
+        uint32_t angle;
+        uint32_t layout;
+        uint32_t length;
+};
+
+struct Serve_reply {
+        uint32_t status;        /* 0 on success */
+        uint32_t length;
+};
+
+/* Transforms one image, writing the result to out; returns 0 on success */
+typedef int Serve_handler(const char *image, size_t length, FILE *out,
+                          int angle, int layout);
+
+/* Listens on path with nworkers threads until killed; returns nonzero
+ * if the socket cannot be set up
+ */
+extern int Serve_run(const char *path, int nworkers, Serve_handler *handler);
+
+/* Moves exactly len bytes; return 0 on success, -1 on error or EOF */
+extern int Serve_read_all(int fd, void *buf, size_t len);
+extern int Serve_write_all(int fd, const void *buf, size_t len);
+
+#endif
@@ -0,0 +1,124 @@
+/**************************************************************
+ *                     stats.c
+ *
+ *     implementation of the image statistics. Every part of a partial
+ *     merges by addition, min or max, so partials can be merged in
+ *     any grouping and the checksum does not depend on the order the
+ *     pixels were visited in.
+ *
+ **************************************************************/
+
+#include <limits.h>
+#include <string.h>
+
+#include "assert.h"
+#include "stats.h"
+#include "pnm.h"
+
+static unsigned long long mix(unsigned long long x);
+
+/**********Stats_init********
+ * Empties a partial: no pixels, with min and max ready to be lowered
+ * and raised
+ ************************/
+void Stats_init(struct Stats *stats)
+{
+        assert(stats != NULL);
+        memset(stats, 0, sizeof(*stats));
+        for (int c = 0; c < 3; c++) {
+                stats->min[c] = UINT_MAX;
+        }
+}
+
+/**********Stats_accumulate********
+ * Folds one pixel into a partial
+ * Inputs:
+ *              int col, row: where the pixel is
+ *              void *pixel: a struct Pnm_rgb
+ *              void *partial: a struct Stats
+ *              void *cl: the image's denominator (an unsigned)
+ * Return: N/A
+ * Expects: samples no larger than the denominator
+ ************************/
+void Stats_accumulate(int col, int row, void *pixel, void *partial, void *cl)
+{
+        Pnm_rgb rgb = pixel;
+        struct Stats *stats = partial;
+        unsigned long long bins = (unsigned long long) *(unsigned *) cl + 1;
+        unsigned value[3] = { rgb->red, rgb->green, rgb->blue };
+
+        stats->count++;
+        for (int c = 0; c < 3; c++) {
+                stats->sum[c] += value[c];
+                stats->min[c] = value[c] < stats->min[c] ? value[c]
+                                                         : stats->min[c];
+                stats->max[c] = value[c] > stats->max[c] ? value[c]
+                                                         : stats->max[c];
+                stats->histogram[c][value[c] * STATS_BINS / bins]++;
+        }
+        stats->checksum += mix(((unsigned long long) row << 32 | col)
+                               ^ mix(((unsigned long long) value[0] << 32 |
+                                      value[1]) ^ (unsigned long long)
+                                     value[2] << 48));
+}
+
+/**********Stats_merge********
+ * Folds the partial other into partial
+ ************************/
+void Stats_merge(void *partial, const void *other, void *cl)
+{
+        struct Stats *stats = partial;
+        const struct Stats *more = other;
+        (void) cl;
+
+        stats->count += more->count;
+        for (int c = 0; c < 3; c++) {
+                stats->sum[c] += more->sum[c];
+                stats->min[c] = more->min[c] < stats->min[c] ? more->min[c]
+                                                             : stats->min[c];
+                stats->max[c] = more->max[c] > stats->max[c] ? more->max[c]
+                                                             : stats->max[c];
+                for (int b = 0; b < STATS_BINS; b++) {
+                        stats->histogram[c][b] += more->histogram[c][b];
+                }
+        }
+        stats->checksum += more->checksum;
+}
+
+/**********Stats_print********
+ * Writes the statistics as a JSON object with one member per channel
+ ************************/
+void Stats_print(FILE *fp, const struct Stats *stats)
+{
+        static const char *names[3] = { "red", "green", "blue" };
+        assert(fp != NULL && stats != NULL);
+
+        fprintf(fp, "{\"pixels\": %llu, \"checksum\": \"%016llx\"",
+                stats->count, stats->checksum);
+        for (int c = 0; c < 3; c++) {
+                double mean = stats->count == 0 ? 0.0 :
+                              (double) stats->sum[c] / stats->count;
+                fprintf(fp, ",\n \"%s\": {\"mean\": %.3f, \"min\": %u, "
+                        "\"max\": %u, \"histogram\": [", names[c], mean,
+                        stats->count == 0 ? 0 : stats->min[c],
+                        stats->max[c]);
+                for (int b = 0; b < STATS_BINS; b++) {
+                        fprintf(fp, "%s%llu", b == 0 ? "" : ",",
+                                stats->histogram[c][b]);
+                }
+                fprintf(fp, "]}");
+        }
+        fprintf(fp, "}\n");
+}
+
+/**********mix********
+ * Scrambles 64 bits (the splitmix64 finalizer)
+ ************************/
+static unsigned long long mix(unsigned long long x)
+{
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+}
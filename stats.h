@@ -0,0 +1,35 @@
+/**************************************************************
+ *                     stats.h
+ *
+ *     interface for per-channel image statistics, shaped for the
+ *     A2Methods reduce: Stats_accumulate folds one pixel into a
+ *     partial, Stats_merge folds partials together, and a partial
+ *     fresh from Stats_init is the identity
+ *
+ **************************************************************/
+#ifndef STATS_INCLUDED
+#define STATS_INCLUDED
+
+#include <stdio.h>
+
+#define STATS_BINS 256
+
+struct Stats {
+        unsigned long long count;
+        unsigned long long sum[3];      /* red, green, blue */
+        unsigned min[3], max[3];
+        unsigned long long histogram[3][STATS_BINS];
+        unsigned long long checksum;    /* of positions and values */
+};
+
+extern void Stats_init(struct Stats *stats);
+
+/* cl points to the image's denominator, which scales the histogram */
+extern void Stats_accumulate(int col, int row, void *pixel, void *partial,
+                             void *cl);
+extern void Stats_merge(void *partial, const void *other, void *cl);
+
+/* Writes the statistics as one JSON object */
+extern void Stats_print(FILE *fp, const struct Stats *stats);
+
+#endif
@@ -0,0 +1,320 @@
+/**************************************************************
+ *                     trace.c
+ *
+ *     implementation of phase tracing. A thread's buffer is created on
+ *     its first span and linked into a global list, which is the only
+ *     place a lock is taken; buffers live until the process exits so
+ *     the spans of finished worker threads can still be exported.
+ *
+ **************************************************************/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "assert.h"
+#include "trace.h"
+
+#define MAX_DEPTH 32
+#define MAX_NOTES 64
+
+struct span {
+        const char *name;
+        long long start, end;   /* ns since the trace was enabled */
+};
+
+struct buffer {
+        int tid;
+        int length, capacity;
+        struct span *spans;
+        int depth;
+        int open[MAX_DEPTH];    /* spans begun but not ended */
+        struct buffer *next;
+};
+
+struct note {
+        const char *key;
+        char *text;             /* NULL for numbers */
+        bool json;              /* text is written as is */
+        double value;
+};
+
+static bool enabled = false;
+static long long origin;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct buffer *buffers = NULL;
+static int nthreads = 0;
+static struct note notes[MAX_NOTES];
+static int nnotes = 0;
+static __thread struct buffer *mine = NULL;
+
+static long long now(void);
+static struct buffer *buffer_new(void);
+static void write_string(FILE *fp, const char *s);
+
+/**********Trace_enable********
+ * Starts recording spans, with time measured from the first call
+ ************************/
+void Trace_enable(void)
+{
+        if (enabled) {
+                return;
+        }
+        origin = now();
+        enabled = true;
+}
+
+bool Trace_enabled(void)
+{
+        return enabled;
+}
+
+/**********Trace_begin********
+ * Opens a span on the calling thread
+ * Inputs: const char *name: the phase, usually a string literal
+ * Expects: spans nest at most MAX_DEPTH deep
+ ************************/
+void Trace_begin(const char *name)
+{
+        if (!enabled) {
+                return;
+        }
+        if (mine == NULL) {
+                mine = buffer_new();
+        }
+        assert(mine->depth < MAX_DEPTH);
+        if (mine->length == mine->capacity) {
+                mine->capacity *= 2;
+                mine->spans = realloc(mine->spans,
+                                      mine->capacity * sizeof(struct span));
+                assert(mine->spans != NULL);
+        }
+        struct span *span = &mine->spans[mine->length];
+        span->name = name;
+        span->start = now();
+        span->end = -1;
+        mine->open[mine->depth++] = mine->length++;
+}
+
+/**********Trace_end********
+ * Closes the calling thread's innermost open span
+ ************************/
+void Trace_end(void)
+{
+        if (!enabled || mine == NULL || mine->depth == 0) {
+                return;
+        }
+        mine->spans[mine->open[--mine->depth]].end = now();
+}
+
+/**********Trace_note_num********
+ * Records a number for the summary, replacing any earlier one with the
+ * same key; ignored while tracing is off
+ ************************/
+void Trace_note_num(const char *key, double value)
+{
+        if (!enabled) {
+                return;
+        }
+        pthread_mutex_lock(&lock);
+        int i;
+        for (i = 0; i < nnotes && strcmp(notes[i].key, key) != 0; i++) {
+        }
+        if (i < MAX_NOTES) {
+                if (i == nnotes) {
+                        nnotes++;
+                }
+                free(notes[i].text);
+                notes[i].key = key;
+                notes[i].text = NULL;
+                notes[i].json = false;
+                notes[i].value = value;
+        }
+        pthread_mutex_unlock(&lock);
+}
+
+/**********Trace_note_str********
+ * Records a string for the summary, replacing any earlier one with the
+ * same key
+ ************************/
+void Trace_note_str(const char *key, const char *value)
+{
+        assert(value != NULL);
+        if (!enabled) {
+                return;
+        }
+        Trace_note_num(key, 0);
+        pthread_mutex_lock(&lock);
+        for (int i = 0; i < nnotes; i++) {
+                if (strcmp(notes[i].key, key) == 0) {
+                        notes[i].text = strdup(value);
+                        assert(notes[i].text != NULL);
+                }
+        }
+        pthread_mutex_unlock(&lock);
+}
+
+/**********Trace_note_json********
+ * Records a JSON value (an object, say) for the summary, written as is
+ ************************/
+void Trace_note_json(const char *key, const char *json)
+{
+        Trace_note_str(key, json);
+        pthread_mutex_lock(&lock);
+        for (int i = 0; i < nnotes; i++) {
+                if (strcmp(notes[i].key, key) == 0) {
+                        notes[i].json = notes[i].text != NULL;
+                }
+        }
+        pthread_mutex_unlock(&lock);
+}
+
+/**********Trace_write_chrome********
+ * Writes every finished span as a complete ("X") event, in the JSON
+ * object format that chrome://tracing and Perfetto load
+ ************************/
+void Trace_write_chrome(FILE *fp)
+{
+        assert(fp != NULL);
+        bool first = true;
+
+        pthread_mutex_lock(&lock);
+        fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+        for (struct buffer *b = buffers; b != NULL; b = b->next) {
+                for (int i = 0; i < b->length; i++) {
+                        struct span *span = &b->spans[i];
+                        if (span->end < 0) {
+                                continue;
+                        }
+                        fprintf(fp, "%s\n{\"name\": ", first ? "" : ",");
+                        write_string(fp, span->name);
+                        fprintf(fp, ", \"ph\": \"X\", \"pid\": 1, "
+                                "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                                b->tid, span->start / 1e3,
+                                (span->end - span->start) / 1e3);
+                        first = false;
+                }
+        }
+        fprintf(fp, "\n]}\n");
+        pthread_mutex_unlock(&lock);
+}
+
+/**********Trace_write_summary********
+ * Writes the notes and the per-phase totals as one line of JSON
+ ************************/
+void Trace_write_summary(FILE *fp)
+{
+        assert(fp != NULL);
+        pthread_mutex_lock(&lock);
+
+        fprintf(fp, "{");
+        for (int i = 0; i < nnotes; i++) {
+                write_string(fp, notes[i].key);
+                fprintf(fp, ": ");
+                if (notes[i].json) {
+                        fputs(notes[i].text, fp);
+                } else if (notes[i].text != NULL) {
+                        write_string(fp, notes[i].text);
+                } else {
+                        fprintf(fp, "%.17g", notes[i].value);
+                }
+                fprintf(fp, ", ");
+        }
+        fprintf(fp, "\"threads\": %d, \"phases\": {", nthreads);
+
+        /* Each name is summed when first met, in order of appearance */
+        bool first = true;
+        for (struct buffer *b = buffers; b != NULL; b = b->next) {
+                for (int i = 0; i < b->length; i++) {
+                        const char *name = b->spans[i].name;
+                        bool seen = false;
+                        for (struct buffer *c = buffers; c != b && !seen;
+                             c = c->next) {
+                                for (int j = 0; j < c->length && !seen; j++) {
+                                        seen = strcmp(c->spans[j].name,
+                                                      name) == 0;
+                                }
+                        }
+                        for (int j = 0; j < i && !seen; j++) {
+                                seen = strcmp(b->spans[j].name, name) == 0;
+                        }
+                        if (seen) {
+                                continue;
+                        }
+
+                        long long total = 0, longest = 0;
+                        int count = 0;
+                        for (struct buffer *c = b; c != NULL; c = c->next) {
+                                for (int j = 0; j < c->length; j++) {
+                                        struct span *s = &c->spans[j];
+                                        if (s->end < 0 ||
+                                            strcmp(s->name, name) != 0) {
+                                                continue;
+                                        }
+                                        long long ns = s->end - s->start;
+                                        total += ns;
+                                        longest = ns > longest ? ns : longest;
+                                        count++;
+                                }
+                        }
+                        fprintf(fp, "%s", first ? "" : ", ");
+                        write_string(fp, name);
+                        fprintf(fp, ": {\"ns\": %lld, \"count\": %d, "
+                                "\"max_ns\": %lld}", total, count, longest);
+                        first = false;
+                }
+        }
+        fprintf(fp, "}}\n");
+        pthread_mutex_unlock(&lock);
+}
+
+/**********now********
+ * Monotonic time in ns, relative to when tracing was enabled
+ ************************/
+static long long now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec - origin;
+}
+
+/**********buffer_new********
+ * Creates the calling thread's buffer and appends it to the list
+ ************************/
+static struct buffer *buffer_new(void)
+{
+        struct buffer *b = calloc(1, sizeof(*b));
+        assert(b != NULL);
+        b->capacity = 64;
+        b->spans = malloc(b->capacity * sizeof(struct span));
+        assert(b->spans != NULL);
+
+        pthread_mutex_lock(&lock);
+        b->tid = nthreads++;
+        struct buffer **last = &buffers;
+        while (*last != NULL) {
+                last = &(*last)->next;
+        }
+        *last = b;
+        pthread_mutex_unlock(&lock);
+        return b;
+}
+
+/**********write_string********
+ * Writes s as a JSON string
+ ************************/
+static void write_string(FILE *fp, const char *s)
+{
+        putc('"', fp);
+        for (; *s != '\0'; s++) {
+                if (*s == '"' || *s == '\\') {
+                        fprintf(fp, "\\%c", *s);
+                } else if ((unsigned char) *s < 0x20) {
+                        fprintf(fp, "\\u%04x", (unsigned char) *s);
+                } else {
+                        putc(*s, fp);
+                }
+        }
+        putc('"', fp);
+}
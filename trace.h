@@ -0,0 +1,42 @@
+/**************************************************************
+ *                     trace.h
+ *
+ *     interface for phase tracing. Spans are always compiled in; until
+ *     Trace_enable is called each one costs a single test of a flag.
+ *     Each thread records into its own buffer, and the spans can be
+ *     exported as a Chrome trace (chrome://tracing, Perfetto) or
+ *     summed per phase into a JSON summary along with any notes.
+ *
+ **************************************************************/
+#ifndef TRACE_INCLUDED
+#define TRACE_INCLUDED
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Call before any thread that should be traced starts; later calls do
+ * nothing
+ */
+extern void Trace_enable(void);
+extern bool Trace_enabled(void);
+
+/* Spans nest within a thread; name must outlive the trace */
+extern void Trace_begin(const char *name);
+extern void Trace_end(void);
+
+/* Facts about the run, written into the summary; key must outlive the
+ * trace and value is copied. Ignored until Trace_enable.
+ */
+extern void Trace_note_num(const char *key, double value);
+extern void Trace_note_str(const char *key, const char *value);
+extern void Trace_note_json(const char *key, const char *json);
+
+/* Every span as a Chrome trace event array */
+extern void Trace_write_chrome(FILE *fp);
+
+/* One line of JSON: the notes, then each span name's total, count and
+ * longest time in ns over all threads
+ */
+extern void Trace_write_summary(FILE *fp);
+
+#endif
@@ -11,26 +11,89 @@
 #include "uarray.h"
 #include "uarray2.h"
 #include "uarray2b.h"
+#include "blockcodec.h"
+#include "dihedral.h"
+#include "hilbert.h"
+#include "memacct.h"
+#include "padding.h"
 #include "assert.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #define T UArray2b_T
 
+typedef struct Block *Block;
+
 static int UArray2b_blkheight(T array2b);
 static int UArray2b_blkwidth(T array2b);
+static T array_new(int width, int height, int size, int blk_width,
+                   int blk_height);
+static int blocksize_64K(int size);
+static Block block_at(T array2b, int blk_col, int blk_row);
+static Block block_peek(T array2b, int blk_col, int blk_row);
+static Block block_writable(T array2b, int blk_col, int blk_row);
+static Block block_new_raw(T array2b, int blk_col, int blk_row);
+static int cell_index(T array2b, Block blk, int col, int row);
+static void block_release(Block blk);
+static void block_free(Block blk);
+static void map_block(T array2b, int blk_col, int blk_row, int write,
+                      const struct UArray2b_schedule *schedule, int ahead,
+                      void apply(int col, int row, T array2b, void *elem,
+                                 void *cl),
+                      void *cl);
+static void map_block_hilbert(T array2b, int blk_col, int blk_row,
+                              void apply(int col, int row, T array2b,
+                                         void *elem, void *cl),
+                              void *cl);
+static void block_in_order(T array2b, int serpentine, int k, int *blk_col,
+                           int *blk_row);
+static UArray_T block_elems(T array2b, Block blk);
+static void block_pack(T array2b, Block blk);
+static void cache_evict(T array2b);
+static void cache_remove(T array2b, Block blk);
 
 const int blocksize_64KB = 65536;
 
+/* Kind of a block that is always expanded (uncompressed arrays) */
+#define BLOCK_RAW 0
+
+struct Block {
+        int kind;               /* BLOCK_RAW or a CODEC_ kind */
+        int nbytes;             /* length of packed */
+        unsigned char *packed;  /* encoded cells, NULL for raw blocks */
+        UArray_T elems;         /* expanded cells, NULL unless resident */
+        int dirty;              /* elems may no longer match packed */
+        unsigned long stamp;    /* last use, for LRU eviction */
+        int refs;               /* arrays sharing the block */
+        int offset;             /* cells before the first, staggering
+                                   neighbouring blocks' cache sets */
+};
+
 struct T {
         int width;
         int height;
         int size;
-        int blocksize;
+        int blk_width;          /* cells in a row of a block */
+        int blk_height;         /* rows in a block */
+        int blk_pitch;          /* cells from one block row to the next,
+                                   padded past blk_width if it aliases */
+        int stagger;            /* cells a block's start moves per slot
+                                   of PADDING_SLOTS, 0 for none */
         int blkheight;
         int blkwidth;
         UArray2_T block_arr;
+        void *zero;             /* one zero cell, read for untouched blocks */
+
+        /* Only used by compressed arrays */
+        int compressed;
+        int cache_len;          /* most blocks expanded at once */
+        int resident;           /* blocks expanded right now */
+        Block *cache;           /* the expanded blocks */
+        Block pinned;           /* block being mapped, never evicted */
+        unsigned long clock;    /* source of LRU stamps */
 };
 
 /**********UArray2b_new********
@@ -43,52 +106,52 @@ struct T {
  *              int blocksize: length of one dimension of a block
  * Return: UArray2b_T object
  * Expects: all parameters to be positive         
+ * Notes: no block is allocated until its first UArray2b_at (or map), so
+ *        arrays that are only partly written only pay for what they use
  ************************/
 UArray2b_T UArray2b_new(int width, int height, int size, int blocksize)
 {
-        /* Ensures proper parameters are passed in */
-        assert(blocksize > 0);
-        assert(width > 0);
-        assert(height > 0);
-        assert(size > 0);
-        /* Allocate space for struct */
-        T barray = malloc(sizeof(*barray));
-        assert(barray != NULL);
-
-        /* Initialize struct values */
-        barray -> width = width;
-        barray -> height = height;
-        barray -> size = size;
-        barray -> blocksize = blocksize;
+        return array_new(width, height, size, blocksize, blocksize);
+}
 
-        /* Gets number of blocks wide */
-        barray -> blkwidth = width / blocksize;
-        if (width % blocksize != 0)
-        {
-                (barray -> blkwidth)++;
-        }
-        /* Gets number of blocks high */
-        barray -> blkheight = height / blocksize;
-        if (height % blocksize != 0)
-        {
-                (barray -> blkheight)++;
-        }
-        
-        UArray_T dummy;
-        barray -> block_arr = UArray2_new(barray->blkwidth, barray->blkheight,
-                        (sizeof(dummy)));
+/**********UArray2b_new_rect********
+ * Creates a new UArray2b_T whose blocks are blk_width cells wide and
+ * blk_height cells high
+ * Inputs:
+ *              int width, height, size: as for UArray2b_new
+ *              int blk_width, blk_height: shape of one block
+ * Return: UArray2b_T object
+ * Expects: all parameters to be positive
+ * Notes: lets a block row span whole cache lines, e.g. 64x8 blocks of
+ *        4-byte cells are 256-byte rows
+ ************************/
+UArray2b_T UArray2b_new_rect(int width, int height, int size, int blk_width,
+                             int blk_height)
+{
+        return array_new(width, height, size, blk_width, blk_height);
+}
 
-        /* Generates each block (puts UArrays in each block) */
-        for (int i = 0; i < barray->blkheight; i++) {
-                for (int j = 0; j < barray->blkwidth; j++) {
-                        UArray_T *block;
+/**********UArray2b_alloc_range********
+ * Allocates the blocks numbered first to last - 1, counting in the order
+ * UArray2b_map visits them, unless they are already allocated
+ * Inputs:
+ *              UArray2b_T array2b: an uncompressed array
+ *              int first, last: range of block numbers
+ * Return: N/A
+ * Expects: the range lies within UArray2b_nblocks
+ * Notes: lets each worker thread allocate (and so first touch) the
+ *        blocks it will later work on
+ ************************/
+void UArray2b_alloc_range(T array2b, int first, int last)
+{
+        assert(array2b != NULL && !array2b->compressed);
+        assert(0 <= first && first <= last);
+        assert(last <= array2b->blkwidth * array2b->blkheight);
 
-                        block = UArray2_at(barray -> block_arr, j, i);
-                        *block = UArray_new(blocksize * blocksize,
-                                (barray->size));
-                }
+        for (int k = first; k < last; k++) {
+                block_at(array2b, k % array2b->blkwidth,
+                         k / array2b->blkwidth);
         }
-        return barray;
 }
 
 /**********UArray2b_new_64K_block********
@@ -105,14 +168,59 @@ UArray2b_T UArray2b_new(int width, int height, int size, int blocksize)
  ************************/
 UArray2b_T UArray2b_new_64K_block(int width, int height, int size)
 {
-        if (size > blocksize_64KB) {
-                return UArray2b_new(width, height, size, 1);
+        return UArray2b_new(width, height, size, blocksize_64K(size));
+}
+
+/**********UArray2b_new_compressed********
+ * Creates a new UArray2b_T object whose blocks are stored packed and only
+ * expanded while they are in use. Every block starts out as a uniform
+ * block of zero bytes.
+ * Inputs:
+ *              int width, height, size, blocksize: as for UArray2b_new,
+ *                        except blocksize <= 0 picks the 64KB blocksize
+ *              int cache_blocks: most blocks expanded at once, <= 0 picks
+ *                        one block row plus one block column
+ * Return: UArray2b_T object
+ * Expects: width, height and size to be positive
+ * Notes: a pointer returned by UArray2b_at is only valid until the next
+ *        access to the same array, which may evict its block
+ ************************/
+UArray2b_T UArray2b_new_compressed(int width, int height, int size,
+                                   int blocksize, int cache_blocks)
+{
+        if (blocksize <= 0) {
+                blocksize = blocksize_64K(size);
+        }
+        T barray = array_new(width, height, size, blocksize, blocksize);
+
+        /* Codecs work on packed blocks of blocksize * blocksize cells */
+        barray -> blk_pitch = blocksize;
+        barray -> stagger = 0;
+        barray -> compressed = 1;
+        barray -> cache_len = cache_blocks;
+        if (cache_blocks <= 0) {
+                barray -> cache_len = barray->blkwidth + barray->blkheight;
         }
-        else {
-                /* In case can fit in 64KB memory */
-                int blocksize = sqrt(blocksize_64KB / size);
-                return UArray2b_new(width, height, size, blocksize);
+        /* Mapping pins one block, so at least one more must fit */
+        if (barray -> cache_len < 2) {
+                barray -> cache_len = 2;
+        }
+        barray -> cache = malloc(barray->cache_len * sizeof(Block));
+        assert(barray -> cache != NULL);
+
+        for (int i = 0; i < barray->blkheight; i++) {
+                for (int j = 0; j < barray->blkwidth; j++) {
+                        Block *block = UArray2_at(barray -> block_arr, j, i);
+                        *block = calloc(1, sizeof(**block));
+                        assert(*block != NULL);
+                        (*block) -> refs = 1;
+                        (*block) -> kind = CODEC_UNIFORM;
+                        (*block) -> nbytes = size;
+                        (*block) -> packed = calloc(1, size);
+                        assert((*block) -> packed != NULL);
+                }
         }
+        return barray;
 }
 
 /**********UArray2b_free********
@@ -128,16 +236,21 @@ void UArray2b_free(T *array2b)
         assert(array2b != NULL);
         assert(*array2b != NULL);
 
-        UArray_T *block;
         /* Loops through blocked array and frees each block */
         for (int i = 0; i < UArray2b_blkheight(*array2b); i++) {
                 for (int j = 0; j < UArray2b_blkwidth(*array2b); j++) {
-                        block = UArray2_at((*array2b) -> block_arr, j, i);
-                        UArray_free(block);
+                        Block block = *(Block *) UArray2_at(
+                                (*array2b) -> block_arr, j, i);
+                        if (block == NULL) {
+                                continue;       /* never allocated */
+                        }
+                        block_release(block);
                 }
         }
 
         UArray2_free(&(*array2b)->block_arr);
+        free((*array2b) -> zero);
+        free((*array2b) -> cache);
         free(*array2b);
 }
 
@@ -187,12 +300,60 @@ int UArray2b_size(T array2b)
  * Return: integer that represents the length of one dimension of a block
  *         within the UArray2b
  * Expects: array2b is not null
- *      
+ * Notes: for rectangular blocks, the square root of the cells in a block
+ *        (rounded down), as the course interface defines it
  ************************/
 int UArray2b_blocksize(T array2b)
 {
         assert(array2b != NULL);
-        return array2b -> blocksize;
+        if (array2b -> blk_width == array2b -> blk_height) {
+                return array2b -> blk_width;
+        }
+        return sqrt((double) array2b->blk_width * array2b->blk_height);
+}
+
+/**********UArray2b_block_width********
+ * Returns the number of cells in one row of a block
+ * Expects: array2b is not null
+ ************************/
+int UArray2b_block_width(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b -> blk_width;
+}
+
+/**********UArray2b_block_height********
+ * Returns the number of rows in a block
+ * Expects: array2b is not null
+ ************************/
+int UArray2b_block_height(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b -> blk_height;
+}
+
+/**********UArray2b_nblocks********
+ * Returns the number of blocks in the UArray2b
+ * Inputs: UArray2b struct object
+ * Return: blocks wide times blocks high
+ * Expects: array2b is not null
+ ************************/
+int UArray2b_nblocks(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b -> blkwidth * array2b -> blkheight;
+}
+
+/**********UArray2b_compressed********
+ * Returns nonzero if the UArray2b keeps its blocks packed
+ * Inputs: UArray2b struct object
+ * Return: 1 for arrays made by UArray2b_new_compressed, else 0
+ * Expects: array2b is not null
+ ************************/
+int UArray2b_compressed(T array2b)
+{
+        assert(array2b != NULL);
+        return array2b -> compressed;
 }
 
 /**********UArray2b_blkheight********
@@ -239,6 +400,10 @@ static int UArray2b_blkwidth(T array2b)
  * Return: pointer to the cell
  * Expects: col and row have to correspond to a valid position in a valid
  *          UArray2
+ * Notes: cells are stored row by row within a block, the order in which
+ *        UArray2b_map visits them. The caller may write through the
+ *        pointer, so a compressed block is marked dirty; UArray2b_get
+ *        reads without doing so
  *      
  ************************/
 void *UArray2b_at(T array2b, int column, int row)
@@ -250,23 +415,56 @@ void *UArray2b_at(T array2b, int column, int row)
         assert(row >= 0);
         assert(row < UArray2b_height(array2b));
 
-        int blksize = UArray2b_blocksize(array2b);
+        int blk_width = array2b -> blk_width;
+        int blk_height = array2b -> blk_height;
 
         /* Gets index of the block */
-        int blk_col = column / blksize;
-        int blk_row = row / blksize;
+        int blk_col = column / blk_width;
+        int blk_row = row / blk_height;
 
-        UArray_T *blk = UArray2_at(array2b -> block_arr, blk_col, blk_row);
+        Block blk = block_writable(array2b, blk_col, blk_row);
 
         /* Gets index in 1D representation */
-        int index = blksize * (column % blksize) + (row % blksize);
+        int index = cell_index(array2b, blk, column % blk_width,
+                               row % blk_height);
 
-        assert(*blk != NULL);
-        assert(blk != NULL);
-        
-        assert(UArray_at(*blk, index) != NULL);
+        UArray_T elems = blk -> elems;
+        if (array2b -> compressed) {
+                /* Caller may write through the pointer */
+                elems = block_elems(array2b, blk);
+                blk -> dirty = 1;
+        }
+        assert(elems != NULL);
         
-        return UArray_at(*blk, index);
+        return UArray_at(elems, index);
+}
+
+/**********UArray2b_get********
+ * Returns a pointer for reading the cell at (col, row), without
+ * allocating its block
+ * Inputs: same as UArray2b_at
+ * Return: pointer to the cell, or to a shared zero cell if the cell's
+ *         block was never touched
+ * Expects: col and row lie in the array
+ * Notes: the cell must not be written through the pointer; on compressed
+ *        arrays the pointer stays valid only until the next access
+ ************************/
+const void *UArray2b_get(T array2b, int col, int row)
+{
+        assert(array2b != NULL);
+        assert(col >= 0 && col < array2b->width);
+        assert(row >= 0 && row < array2b->height);
+
+        int bw = array2b -> blk_width, bh = array2b -> blk_height;
+        Block blk = block_peek(array2b, col / bw, row / bh);
+        if (blk == NULL) {
+                return array2b -> zero;
+        }
+        UArray_T elems = blk -> elems;
+        if (array2b -> compressed) {
+                elems = block_elems(array2b, blk);
+        }
+        return UArray_at(elems, cell_index(array2b, blk, col % bw, row % bh));
 }
 
 /**********UArray2b_map********
@@ -284,25 +482,913 @@ void UArray2b_map(T array2b, void apply(int col, int row, T array2b,
         void *elem, void *cl), void *cl)
 {
         assert(array2b != NULL);
-        int blksize = UArray2b_blocksize(array2b);
-        (void) cl;
 
         /* Loops through the blocked array */
         for (int i = 0; i < UArray2b_blkheight(array2b); i++) {
                 for (int j = 0; j < UArray2b_blkwidth(array2b); j++) {
-                        /* Loops through the block */
-                        for (int k = 0; k < (blksize * blksize); k++) {
-                                int col_idx = (blksize * j) + (k % blksize);
-                                int row_idx = (blksize * i) + (k / blksize);
-                                if (row_idx < UArray2b_height(array2b)) {
-                                        if (col_idx < UArray2b_width(array2b)) {
-                                        void *elem = UArray2b_at(array2b, 
-                                                col_idx, row_idx);
-                                        apply(col_idx, row_idx, array2b, elem, 
-                                                cl);
-                                        }
-                                }       
+                        map_block(array2b, j, i, 1, NULL, -1, apply, cl);
+                }
+        }
+}
+
+/* A Hilbert-order map in progress: the block being walked, if any */
+struct hilbert_map {
+        T array2b;
+        int cells;
+        void (*apply)(int col, int row, T array2b, void *elem, void *cl);
+        void *cl;
+        UArray_T elems;
+        Block blk;
+        int col0, row0;
+};
+
+static void visit_block(int blk_col, int blk_row, void *vmap)
+{
+        struct hilbert_map *map = vmap;
+        if (map->cells) {
+                map_block_hilbert(map->array2b, blk_col, blk_row, map->apply,
+                                  map->cl);
+        } else {
+                map_block(map->array2b, blk_col, blk_row, 1, NULL, -1,
+                          map->apply, map->cl);
+        }
+}
+
+static void visit_cell(int col, int row, void *vmap)
+{
+        struct hilbert_map *map = vmap;
+        void *elem = UArray_at(map->elems,
+                               cell_index(map->array2b, map->blk, col, row));
+        map->apply(map->col0 + col, map->row0 + row, map->array2b, elem,
+                   map->cl);
+}
+
+/**********UArray2b_map_hilbert********
+ * Like UArray2b_map, but visits the blocks along a Hilbert curve, so
+ * that consecutive blocks are always neighbours
+ * Inputs:
+ *              UArray2b_T array2b: the array
+ *              int cells: nonzero to visit each block's cells along a
+ *                         Hilbert curve too, rather than row by row
+ *              apply, cl: as for UArray2b_map
+ * Return: N/A
+ * Expects: array2b non NULL
+ ************************/
+void UArray2b_map_hilbert(T array2b, int cells,
+                          void apply(int col, int row, T array2b, void *elem,
+                                     void *cl),
+                          void *cl)
+{
+        assert(array2b != NULL);
+        struct hilbert_map map = { array2b, cells, apply, cl, NULL, NULL,
+                                   0, 0 };
+        Hilbert_walk(array2b->blkwidth, array2b->blkheight, visit_block,
+                     &map);
+}
+
+/**********UArray2b_map_touched********
+ * Like UArray2b_map, but skips blocks that were never touched, whose
+ * cells are all zero
+ * Inputs: same as UArray2b_map
+ * Return: N/A
+ * Expects: array2b non NULL
+ * Notes: every block of a compressed array counts as touched
+ ************************/
+void UArray2b_map_touched(T array2b, void apply(int col, int row, T array2b,
+                                                void *elem, void *cl),
+                          void *cl)
+{
+        assert(array2b != NULL);
+
+        for (int i = 0; i < array2b->blkheight; i++) {
+                for (int j = 0; j < array2b->blkwidth; j++) {
+                        if (block_peek(array2b, j, i) != NULL) {
+                                map_block(array2b, j, i, 1, NULL, -1, apply, cl);
                         }
                 }
         }
-}
\ No newline at end of file
+}
+
+/**********UArray2b_map_range********
+ * Like UArray2b_map, but only visits the blocks numbered first to
+ * last - 1 in UArray2b_map's order
+ * Inputs:
+ *              UArray2b_T array2b: the array
+ *              int first, last: range of block numbers
+ *              apply, cl: as for UArray2b_map
+ * Return: N/A
+ * Expects: the range lies within UArray2b_nblocks
+ * Notes: threads may map disjoint ranges of an uncompressed array at once
+ ************************/
+void UArray2b_map_range(T array2b, int first, int last,
+                        void apply(int col, int row, T array2b, void *elem,
+                                   void *cl),
+                        void *cl)
+{
+        assert(array2b != NULL);
+        assert(0 <= first && first <= last);
+        assert(last <= UArray2b_nblocks(array2b));
+
+        for (int k = first; k < last; k++) {
+                map_block(array2b, k % array2b->blkwidth,
+                          k / array2b->blkwidth, 1, NULL, -1, apply, cl);
+        }
+}
+
+/**********UArray2b_read_range********
+ * Like UArray2b_map_range, but for reading only: untouched blocks are
+ * not allocated and shared blocks are not copied
+ * Inputs: same as UArray2b_map_range
+ * Return: N/A
+ * Expects: apply does not write through elem
+ * Notes: cells of untouched blocks are all passed the shared zero cell;
+ *        threads may read any ranges of an uncompressed array at once
+ ************************/
+void UArray2b_read_range(T array2b, int first, int last,
+                         void apply(int col, int row, T array2b, void *elem,
+                                    void *cl),
+                         void *cl)
+{
+        assert(array2b != NULL);
+        assert(0 <= first && first <= last);
+        assert(last <= UArray2b_nblocks(array2b));
+
+        for (int k = first; k < last; k++) {
+                map_block(array2b, k % array2b->blkwidth,
+                          k / array2b->blkwidth, 0, NULL, -1, apply, cl);
+        }
+}
+
+/**********UArray2b_map_scheduled********
+ * Like UArray2b_map, but visits the blocks in the schedule's order and
+ * prefetches the block the schedule's distance ahead of the one being
+ * visited
+ * Inputs:
+ *              UArray2b_T array2b: the array
+ *              const struct UArray2b_schedule *schedule: order and lookahead
+ *              apply, cl: as for UArray2b_map
+ * Return: N/A
+ * Expects: a non-negative distance
+ * Notes: the prefetches are spread over the visited block, one row of
+ *        the block ahead per row visited, so they never pile up
+ ************************/
+void UArray2b_map_scheduled(T array2b, const struct UArray2b_schedule *schedule,
+                            void apply(int col, int row, T array2b, void *elem,
+                                       void *cl),
+                            void *cl)
+{
+        assert(array2b != NULL && schedule != NULL);
+        assert(schedule->distance >= 0);
+        int nblocks = UArray2b_nblocks(array2b);
+
+        for (int k = 0; k < nblocks; k++) {
+                int blk_col, blk_row;
+                block_in_order(array2b, schedule->serpentine, k, &blk_col,
+                               &blk_row);
+                int ahead = schedule->distance > 0 &&
+                            k + schedule->distance < nblocks ?
+                            k + schedule->distance : -1;
+                map_block(array2b, blk_col, blk_row, 1, schedule, ahead,
+                          apply, cl);
+        }
+}
+
+/**********UArray2b_prefetch********
+ * Issues a prefetch for every cache line the cells of a rectangle live in
+ * Inputs:
+ *              UArray2b_T array2b: the array
+ *              int col, row, width, height: the rectangle
+ *              int write: nonzero if the cells are about to be written
+ * Return: N/A
+ * Expects: the rectangle lies inside the array
+ * Notes: blocks of compressed arrays, and blocks not allocated yet, have
+ *        no fixed home to prefetch
+ ************************/
+void UArray2b_prefetch(T array2b, int col, int row, int width, int height,
+                       int write)
+{
+        assert(array2b != NULL);
+        assert(col >= 0 && row >= 0 && width >= 0 && height >= 0);
+        assert(col + width <= array2b->width);
+        assert(row + height <= array2b->height);
+        if (array2b->compressed) {
+                return;
+        }
+        int bw = array2b->blk_width, bh = array2b->blk_height;
+
+        for (int r = row; r < row + height; r++) {
+                int c = col;
+                /* Cells of one block row are contiguous */
+                while (c < col + width) {
+                        int run = bw - c % bw;
+                        run = run < col + width - c ? run : col + width - c;
+                        Block blk = block_peek(array2b, c / bw, r / bh);
+                        if (blk == NULL) {
+                                c += run;
+                                continue;
+                        }
+                        char *first = UArray_at(blk->elems,
+                                cell_index(array2b, blk, c % bw, r % bh));
+                        char *last = first + (size_t) run * array2b->size - 1;
+                        uintptr_t line = (uintptr_t) first & ~(uintptr_t) 63;
+                        for (; line <= (uintptr_t) last; line += 64) {
+                                if (write) {
+                                        __builtin_prefetch((void *) line, 1);
+                                } else {
+                                        __builtin_prefetch((void *) line, 0);
+                                }
+                        }
+                        c += run;
+                }
+        }
+}
+
+/**********UArray2b_place********
+ * Hands the storage of every block to a placement function, split into
+ * nparts contiguous runs of blocks exactly as Parallel_run splits items
+ * Inputs:
+ *              UArray2b_T array2b: an uncompressed array
+ *              int nparts: number of runs
+ *              place: called with each block's cells, their size in bytes
+ *                     and the run the block belongs to
+ *              void *cl: passed through to place
+ * Return: N/A
+ * Expects: every block allocated, nparts positive
+ ************************/
+void UArray2b_place(T array2b, int nparts,
+                    void place(void *mem, size_t bytes, int part, void *cl),
+                    void *cl)
+{
+        assert(array2b != NULL && !array2b->compressed && nparts > 0);
+        int nblocks = UArray2b_nblocks(array2b);
+
+        for (int part = 0; part < nparts; part++) {
+                int first = (long) nblocks * part / nparts;
+                int last = (long) nblocks * (part + 1) / nparts;
+                for (int k = first; k < last; k++) {
+                        Block blk = block_at(array2b, k % array2b->blkwidth,
+                                             k / array2b->blkwidth);
+                        size_t bytes = (size_t) UArray_length(blk->elems) *
+                                       array2b->size;
+                        place(UArray_at(blk->elems, 0), bytes, part, cl);
+                }
+        }
+}
+
+/**********UArray2b_place_owned********
+ * Hands the storage of every allocated block to a placement function,
+ * with the part chosen per block by an owner function, for arrays whose
+ * blocks are not split into runs the way their users' work is, such as
+ * the source of a rotation split by destination
+ * Inputs:
+ *              UArray2b_T array2b: an uncompressed array
+ *              owner: returns the part of the block holding the cell at
+ *                     (col, row), called with the block's middle cell
+ *              place: called with each block's cells, their size in bytes
+ *                     and the part owner chose
+ *              void *cl: passed through to owner and place
+ * Return: N/A
+ * Notes: blocks never touched are left unallocated
+ ************************/
+void UArray2b_place_owned(T array2b, int owner(int col, int row, void *cl),
+                          void place(void *mem, size_t bytes, int part,
+                                     void *cl),
+                          void *cl)
+{
+        assert(array2b != NULL && !array2b->compressed);
+        int bw = array2b -> blk_width, bh = array2b -> blk_height;
+
+        for (int blk_row = 0; blk_row < array2b->blkheight; blk_row++) {
+                for (int blk_col = 0; blk_col < array2b->blkwidth;
+                     blk_col++) {
+                        Block blk = block_peek(array2b, blk_col, blk_row);
+                        if (blk == NULL) {
+                                continue;
+                        }
+                        int col = blk_col * bw, row = blk_row * bh;
+                        int w = array2b->width - col;
+                        int h = array2b->height - row;
+                        col += (w < bw ? w : bw) / 2;
+                        row += (h < bh ? h : bh) / 2;
+                        size_t bytes = (size_t) UArray_length(blk->elems) *
+                                       array2b->size;
+                        place(UArray_at(blk->elems, 0), bytes,
+                              owner(col, row, cl), cl);
+                }
+        }
+}
+
+/**********UArray2b_fill********
+ * Copies one element into every cell of a rectangle
+ * Inputs:
+ *              UArray2b_T array2b: the array to fill
+ *              int col, row: top left cell of the rectangle
+ *              int width, height: dimensions of the rectangle
+ *              const void *elem: the element to copy
+ * Return: N/A
+ * Expects: the rectangle lies inside the array and elem does not point
+ *          into array2b
+ * Notes: on compressed arrays, blocks whose cells are all covered are
+ *        replaced by a uniform block without being expanded
+ ************************/
+void UArray2b_fill(T array2b, int col, int row, int width, int height,
+                   const void *elem)
+{
+        assert(array2b != NULL && elem != NULL);
+        assert(col >= 0 && row >= 0 && width >= 0 && height >= 0);
+        assert(col + width <= array2b->width);
+        assert(row + height <= array2b->height);
+        if (width == 0 || height == 0) {
+                return;
+        }
+
+        int bw = array2b -> blk_width, bh = array2b -> blk_height;
+        int size = array2b -> size;
+
+        for (int i = row / bh; i <= (row + height - 1) / bh; i++) {
+                for (int j = col / bw; j <= (col + width - 1) / bw; j++) {
+                        /* In bounds part of the block */
+                        int bc0 = j * bw, br0 = i * bh;
+                        int bc1 = bc0 + bw, br1 = br0 + bh;
+                        bc1 = bc1 < array2b->width ? bc1 : array2b->width;
+                        br1 = br1 < array2b->height ? br1 : array2b->height;
+
+                        if (array2b->compressed && col <= bc0 && row <= br0
+                            && col + width >= bc1 && row + height >= br1) {
+                                Block blk = block_at(array2b, j, i);
+                                if (blk -> elems != NULL) {
+                                        cache_remove(array2b, blk);
+                                        UArray_free(&blk -> elems);
+                                }
+                                free(blk -> packed);
+                                blk -> packed = malloc(size);
+                                assert(blk -> packed != NULL);
+                                memcpy(blk -> packed, elem, size);
+                                blk -> kind = CODEC_UNIFORM;
+                                blk -> nbytes = size;
+                                blk -> dirty = 0;
+                                continue;
+                        }
+
+                        /* Intersection of the block and the rectangle */
+                        int c0 = col > bc0 ? col : bc0;
+                        int r0 = row > br0 ? row : br0;
+                        int c1 = col + width < bc1 ? col + width : bc1;
+                        int r1 = row + height < br1 ? row + height : br1;
+                        for (int r = r0; r < r1; r++) {
+                                for (int c = c0; c < c1; c++) {
+                                        memcpy(UArray2b_at(array2b, c, r),
+                                               elem, size);
+                                }
+                        }
+                }
+        }
+}
+
+/**********UArray2b_copy********
+ * Creates a new array with the same cells as array2b
+ * Inputs: UArray2b_T array2b: the array to copy
+ * Return: the copy, which has array2b's block shape and storage mode
+ * Expects: array2b non NULL
+ * Notes: an uncompressed copy shares every block with array2b, and a
+ *        shared block is only copied once either array writes to it.
+ *        Compressed blocks are copied still packed instead, since each
+ *        array keeps its own cache of expanded blocks.
+ ************************/
+UArray2b_T UArray2b_copy(T array2b)
+{
+        assert(array2b != NULL);
+        if (array2b -> compressed) {
+                return UArray2b_rotate(array2b, 0);
+        }
+
+        T copy = array_new(array2b->width, array2b->height, array2b->size,
+                           array2b->blk_width, array2b->blk_height);
+        /* Shared blocks keep the layout they were made with */
+        copy -> blk_pitch = array2b -> blk_pitch;
+        copy -> stagger = array2b -> stagger;
+        for (int i = 0; i < array2b->blkheight; i++) {
+                for (int j = 0; j < array2b->blkwidth; j++) {
+                        Block blk = block_peek(array2b, j, i);
+                        if (blk == NULL) {
+                                continue;
+                        }
+                        __atomic_add_fetch(&blk -> refs, 1, __ATOMIC_RELAXED);
+                        *(Block *) UArray2_at(copy -> block_arr, j, i) = blk;
+                }
+        }
+        return copy;
+}
+
+/**********UArray2b_rotate********
+ * Creates a new array holding the contents of array2b rotated clockwise
+ * Inputs:
+ *              UArray2b_T array2b: the source array
+ *              int angle: 0, 90, 180 or 270
+ * Return: a new UArray2b_T with the source's storage mode and block
+ *         shape, turned with the array when the angle swaps dimensions so
+ *         that each source block lands on as few blocks as possible
+ * Expects: array2b non NULL and a valid angle
+ * Notes: packed uniform blocks are written as rectangles rather than cell
+ *        by cell, and at angle 0 packed blocks are copied still packed
+ *        since both arrays share one block grid. At angle 0 uncompressed
+ *        arrays share their blocks, as with UArray2b_copy.
+ ************************/
+UArray2b_T UArray2b_rotate(T array2b, int angle)
+{
+        assert(array2b != NULL);
+        Dihedral_T op = Dihedral_from_angle(angle);
+        if (op == DIHEDRAL_ROT0 && !array2b -> compressed) {
+                return UArray2b_copy(array2b);
+        }
+        int width = array2b -> width;
+        int height = array2b -> height;
+        int size = array2b -> size;
+        int bw = array2b -> blk_width, bh = array2b -> blk_height;
+
+        int swaps = Dihedral_swaps_dims(op);
+        int new_width = swaps ? height : width;
+        int new_height = swaps ? width : height;
+        T rotated;
+        if (array2b -> compressed) {
+                /* Compressed blocks are always square */
+                rotated = UArray2b_new_compressed(new_width, new_height, size,
+                                                  bw, array2b->cache_len);
+        } else {
+                rotated = UArray2b_new_rect(new_width, new_height, size,
+                                            swaps ? bh : bw, swaps ? bw : bh);
+        }
+
+        for (int i = 0; i < array2b->blkheight; i++) {
+                for (int j = 0; j < array2b->blkwidth; j++) {
+                        /* Untouched blocks rotate onto untouched blocks */
+                        Block blk = block_peek(array2b, j, i);
+                        if (blk == NULL) {
+                                continue;
+                        }
+                        int col = j * bw, row = i * bh;
+                        int cols = width - col < bw ? width - col : bw;
+                        int rows = height - row < bh ? height - row : bh;
+                        int packed_ok = blk->packed != NULL && !blk->dirty;
+
+                        if (packed_ok && blk->kind == CODEC_UNIFORM) {
+                                Dihedral_rect(op, width, height, &col, &row,
+                                              &cols, &rows);
+                                UArray2b_fill(rotated, col, row, cols, rows,
+                                              blk -> packed);
+                                continue;
+                        }
+                        if (packed_ok && op == DIHEDRAL_ROT0) {
+                                Block copy = block_at(rotated, j, i);
+                                free(copy -> packed);
+                                copy -> packed = malloc(blk->nbytes);
+                                assert(copy -> packed != NULL);
+                                memcpy(copy->packed, blk->packed, blk->nbytes);
+                                copy -> nbytes = blk -> nbytes;
+                                copy -> kind = blk -> kind;
+                                continue;
+                        }
+
+                        /* Expands the block and moves it cell by cell */
+                        UArray_T elems = blk -> elems;
+                        if (array2b -> compressed) {
+                                elems = block_elems(array2b, blk);
+                        }
+                        for (int r = 0; r < rows; r++) {
+                                for (int c = 0; c < cols; c++) {
+                                        int dcol, drow;
+                                        Dihedral_point(op, width, height,
+                                                col + c, row + r,
+                                                &dcol, &drow);
+                                        memcpy(UArray2b_at(rotated, dcol,
+                                                           drow),
+                                               UArray_at(elems,
+                                                         cell_index(array2b,
+                                                                blk, c, r)),
+                                               size);
+                                }
+                        }
+                }
+        }
+        return rotated;
+}
+
+/**********UArray2b_footprint********
+ * Returns the bytes of cell storage held by the array: packed blocks plus
+ * expanded blocks
+ * Inputs: UArray2b struct object
+ * Return: number of bytes
+ * Expects: array2b is not null
+ ************************/
+size_t UArray2b_footprint(T array2b)
+{
+        assert(array2b != NULL);
+        size_t total = 0;
+
+        for (int i = 0; i < array2b->blkheight; i++) {
+                for (int j = 0; j < array2b->blkwidth; j++) {
+                        Block blk = *(Block *) UArray2_at(
+                                array2b -> block_arr, j, i);
+                        if (blk == NULL) {
+                                continue;
+                        }
+                        total += blk -> nbytes;
+                        if (blk -> elems != NULL) {
+                                total += (size_t) UArray_length(blk->elems) *
+                                         array2b->size;
+                        }
+                }
+        }
+        return total;
+}
+
+/**********UArray2b_shared********
+ * Returns nonzero if any block of the array is shared with another
+ * array, as blocks are after UArray2b_copy or an angle-0 rotate
+ * Inputs: UArray2b struct object
+ * Return: 1 if a block has more than one reference, else 0
+ * Expects: array2b is not null
+ ************************/
+int UArray2b_shared(T array2b)
+{
+        assert(array2b != NULL);
+
+        for (int i = 0; i < array2b->blkheight; i++) {
+                for (int j = 0; j < array2b->blkwidth; j++) {
+                        Block blk = *(Block *) UArray2_at(
+                                array2b -> block_arr, j, i);
+                        if (blk != NULL &&
+                            __atomic_load_n(&blk -> refs,
+                                            __ATOMIC_ACQUIRE) > 1) {
+                                return 1;
+                        }
+                }
+        }
+        return 0;
+}
+
+/**********array_new********
+ * Allocates a UArray2b_T and its grid of block pointers, leaving the
+ * blocks themselves to the caller
+ * Inputs: width, height, size and block shape as for UArray2b_new_rect
+ * Return: UArray2b_T object with NULL blocks
+ * Expects: all parameters to be positive
+ ************************/
+static T array_new(int width, int height, int size, int blk_width,
+                   int blk_height)
+{
+        /* Ensures proper parameters are passed in */
+        assert(blk_width > 0 && blk_height > 0);
+        assert(width > 0);
+        assert(height > 0);
+        assert(size > 0);
+        /* Allocate space for struct */
+        T barray = calloc(1, sizeof(*barray));
+        assert(barray != NULL);
+
+        /* Initialize struct values */
+        barray -> width = width;
+        barray -> height = height;
+        barray -> size = size;
+        barray -> blk_width = blk_width;
+        barray -> blk_height = blk_height;
+        barray -> blk_pitch = Padding_pitch(blk_width, size);
+        barray -> stagger = Padding_stagger(size);
+
+        /* Gets number of blocks wide */
+        barray -> blkwidth = width / blk_width;
+        if (width % blk_width != 0)
+        {
+                (barray -> blkwidth)++;
+        }
+        /* Gets number of blocks high */
+        barray -> blkheight = height / blk_height;
+        if (height % blk_height != 0)
+        {
+                (barray -> blkheight)++;
+        }
+
+        barray -> block_arr = UArray2_new(barray->blkwidth, barray->blkheight,
+                        sizeof(Block));
+        barray -> zero = calloc(1, size);
+        assert(barray -> zero != NULL);
+        Mem_count(MEM_UARRAY2B_NEW, sizeof(*barray) + size +
+                  (size_t) barray->blkwidth * barray->blkheight *
+                  sizeof(Block));
+        return barray;
+}
+
+/**********blocksize_64K********
+ * Returns the largest blocksize whose block fits in 64KB
+ * Inputs: int size: bytes per cell
+ * Return: blocksize, at least 1
+ * Expects: size positive
+ ************************/
+static int blocksize_64K(int size)
+{
+        if (size > blocksize_64KB) {
+                return 1;
+        }
+        /* In case can fit in 64KB memory */
+        return sqrt(blocksize_64KB / size);
+}
+
+/**********block_at********
+ * Returns the block in the given block column and block row, allocating
+ * it if this is its first touch
+ * Notes: threads touching the same new block at once race to install
+ *        theirs; the losers free their copies and use the winner's
+ ************************/
+static Block block_at(T array2b, int blk_col, int blk_row)
+{
+        Block *slot = UArray2_at(array2b -> block_arr, blk_col, blk_row);
+        Block blk = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if (blk != NULL) {
+                return blk;
+        }
+
+        Block fresh = block_new_raw(array2b, blk_col, blk_row);
+        if (__atomic_compare_exchange_n(slot, &blk, fresh, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return fresh;
+        }
+        block_free(fresh);
+        return blk;
+}
+
+/**********block_writable********
+ * Returns the block in the given block column and block row, ready to be
+ * written: allocated if this is its first touch, and copied if it is
+ * shared with another array
+ * Notes: a thread that loses a race to install its copy uses the
+ *        winner's, and the shared block loses this array's reference
+ *        only once
+ ************************/
+static Block block_writable(T array2b, int blk_col, int blk_row)
+{
+        Block blk = block_at(array2b, blk_col, blk_row);
+        if (__atomic_load_n(&blk -> refs, __ATOMIC_ACQUIRE) == 1) {
+                return blk;
+        }
+
+        Block *slot = UArray2_at(array2b -> block_arr, blk_col, blk_row);
+        Block copy = block_new_raw(array2b, blk_col, blk_row);
+        assert(UArray_length(copy->elems) == UArray_length(blk->elems));
+        memcpy(UArray_at(copy -> elems, 0), UArray_at(blk -> elems, 0),
+               (size_t) UArray_length(blk->elems) * array2b->size);
+        if (__atomic_compare_exchange_n(slot, &blk, copy, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                block_release(blk);
+                return copy;
+        }
+        block_free(copy);
+        return blk;
+}
+
+/**********block_peek********
+ * Returns the block in the given block column and block row, or NULL if
+ * it was never touched
+ ************************/
+static Block block_peek(T array2b, int blk_col, int blk_row)
+{
+        Block *slot = UArray2_at(array2b -> block_arr, blk_col, blk_row);
+        return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+}
+
+/**********block_new_raw********
+ * Allocates an uncompressed block of zeroed cells for the given block
+ * column and block row, whose position picks its stagger offset
+ ************************/
+static Block block_new_raw(T array2b, int blk_col, int blk_row)
+{
+        Block blk = calloc(1, sizeof(*blk));
+        assert(blk != NULL);
+        blk -> kind = BLOCK_RAW;
+        blk -> refs = 1;
+        /* Neighbours in either direction land in different slots */
+        blk -> offset = (blk_col + blk_row) % PADDING_SLOTS *
+                        array2b->stagger;
+        int nelems = blk->offset + array2b->blk_pitch * array2b->blk_height;
+        blk -> elems = UArray_new(nelems, array2b->size);
+        Mem_count(MEM_UARRAY_NEW, (size_t) nelems * array2b->size);
+        return blk;
+}
+
+/**********cell_index********
+ * Index in a block's elems of the cell col cells across and row rows
+ * down the block
+ ************************/
+static inline int cell_index(T array2b, Block blk, int col, int row)
+{
+        return blk->offset + array2b->blk_pitch * row + col;
+}
+
+/**********block_release********
+ * Drops one array's reference to a block, freeing it with the last
+ ************************/
+static void block_release(Block blk)
+{
+        if (__atomic_sub_fetch(&blk -> refs, 1, __ATOMIC_ACQ_REL) == 0) {
+                block_free(blk);
+        }
+}
+
+/**********block_free********
+ * Frees a block and whatever cells it holds
+ ************************/
+static void block_free(Block blk)
+{
+        if (blk -> elems != NULL) {
+                UArray_free(&blk -> elems);
+        }
+        free(blk -> packed);
+        free(blk);
+}
+
+/**********map_block********
+ * Calls apply on every in-bounds cell of one block, in storage order,
+ * prefetching the block numbered ahead in the schedule's order as it
+ * goes; ahead is -1 (and schedule may be NULL) for no prefetching.
+ * With write 0 the block is only read, so it is neither allocated nor
+ * unshared.
+ ************************/
+static void map_block(T array2b, int blk_col, int blk_row, int write,
+                      const struct UArray2b_schedule *schedule, int ahead,
+                      void apply(int col, int row, T array2b, void *elem,
+                                 void *cl),
+                      void *cl)
+{
+        int bw = array2b -> blk_width, bh = array2b -> blk_height;
+        Block blk = write ? block_writable(array2b, blk_col, blk_row)
+                          : block_peek(array2b, blk_col, blk_row);
+        UArray_T elems = blk != NULL ? blk -> elems : NULL;
+        if (array2b -> compressed) {
+                elems = block_elems(array2b, blk);
+                /* A read leaves earlier writes still to be packed */
+                if (write) {
+                        blk -> dirty = 1;
+                }
+                array2b -> pinned = blk;
+        }
+
+        /* Clips blocks on the right and bottom edges */
+        int col0 = bw * blk_col;
+        int row0 = bh * blk_row;
+        int cols = array2b -> width - col0;
+        int rows = array2b -> height - row0;
+        cols = cols < bw ? cols : bw;
+        rows = rows < bh ? rows : bh;
+
+        /* The block the schedule looks ahead to, clipped the same way */
+        int ahead_col0 = 0, ahead_row0 = 0, ahead_cols = 0, ahead_rows = 0;
+        if (ahead >= 0) {
+                int ahead_blk_col, ahead_blk_row;
+                block_in_order(array2b, schedule->serpentine, ahead,
+                               &ahead_blk_col, &ahead_blk_row);
+                ahead_col0 = bw * ahead_blk_col;
+                ahead_row0 = bh * ahead_blk_row;
+                ahead_cols = array2b -> width - ahead_col0;
+                ahead_rows = array2b -> height - ahead_row0;
+                ahead_cols = ahead_cols < bw ? ahead_cols : bw;
+                ahead_rows = ahead_rows < bh ? ahead_rows : bh;
+        }
+
+        /* Loops through the block in storage order */
+        for (int r = 0; r < rows; r++) {
+                if (r < ahead_rows) {
+                        UArray2b_prefetch(array2b, ahead_col0, ahead_row0 + r,
+                                          ahead_cols, 1, 0);
+                        if (schedule->ahead != NULL) {
+                                schedule->ahead(ahead_col0, ahead_row0 + r,
+                                                ahead_cols, 1, schedule->cl);
+                        }
+                }
+                for (int c = 0; c < cols; c++) {
+                        /* Untouched blocks are read as zero cells */
+                        void *elem = elems != NULL ?
+                                UArray_at(elems,
+                                          cell_index(array2b, blk, c, r)) :
+                                array2b -> zero;
+                        apply(col0 + c, row0 + r, array2b, elem, cl);
+                }
+        }
+        array2b -> pinned = NULL;
+}
+
+/**********map_block_hilbert********
+ * Calls apply on every in-bounds cell of one block, along a Hilbert
+ * curve over the block's clipped cells
+ ************************/
+static void map_block_hilbert(T array2b, int blk_col, int blk_row,
+                              void apply(int col, int row, T array2b,
+                                         void *elem, void *cl),
+                              void *cl)
+{
+        int bw = array2b -> blk_width, bh = array2b -> blk_height;
+        Block blk = block_writable(array2b, blk_col, blk_row);
+        UArray_T elems = blk -> elems;
+        if (array2b -> compressed) {
+                elems = block_elems(array2b, blk);
+                blk -> dirty = 1;
+                array2b -> pinned = blk;
+        }
+
+        struct hilbert_map map = { array2b, 1, apply, cl, elems, blk,
+                                   bw * blk_col, bh * blk_row };
+        int cols = array2b -> width - map.col0;
+        int rows = array2b -> height - map.row0;
+        Hilbert_walk(cols < bw ? cols : bw, rows < bh ? rows : bh,
+                     visit_cell, &map);
+        array2b -> pinned = NULL;
+}
+
+/**********block_in_order********
+ * Finds the block visited k-th: row by row, and with serpentine set,
+ * right to left on odd rows so consecutive blocks stay neighbours
+ ************************/
+static void block_in_order(T array2b, int serpentine, int k, int *blk_col,
+                           int *blk_row)
+{
+        *blk_row = k / array2b -> blkwidth;
+        *blk_col = k % array2b -> blkwidth;
+        if (serpentine && *blk_row % 2 == 1) {
+                *blk_col = array2b -> blkwidth - 1 - *blk_col;
+        }
+}
+
+/**********block_elems********
+ * Returns the expanded cells of a block of a compressed array, decoding
+ * the block into the cache (and evicting the least recently used block)
+ * if it is not already resident
+ * Inputs: the compressed array and one of its blocks
+ * Return: UArray_T of blk_width * blk_height cells
+ * Expects: array2b is compressed
+ ************************/
+static UArray_T block_elems(T array2b, Block blk)
+{
+        blk -> stamp = ++(array2b -> clock);
+        if (blk -> elems != NULL) {
+                return blk -> elems;
+        }
+
+        if (array2b -> resident == array2b -> cache_len) {
+                cache_evict(array2b);
+        }
+        int nelems = array2b->blk_width * array2b->blk_height;
+        blk -> elems = UArray_new(nelems, array2b->size);
+        Mem_count(MEM_UARRAY_NEW, (size_t) nelems * array2b->size);
+        Codec_decode(blk->kind, blk->packed, blk->nbytes,
+                     UArray_at(blk->elems, 0), nelems, array2b->size);
+        blk -> dirty = 0;
+        array2b -> cache[(array2b -> resident)++] = blk;
+        return blk -> elems;
+}
+
+/**********block_pack********
+ * Re-encodes the expanded cells of a block, replacing its packed bytes
+ ************************/
+static void block_pack(T array2b, Block blk)
+{
+        int nelems = array2b->blk_width * array2b->blk_height;
+        free(blk -> packed);
+        blk -> kind = Codec_encode(UArray_at(blk->elems, 0), nelems,
+                                   array2b->size, &blk->packed, &blk->nbytes);
+        blk -> dirty = 0;
+}
+
+/**********cache_evict********
+ * Packs (if written) and releases the least recently used unpinned block
+ ************************/
+static void cache_evict(T array2b)
+{
+        Block victim = NULL;
+        for (int i = 0; i < array2b -> resident; i++) {
+                Block blk = array2b -> cache[i];
+                if (blk != array2b -> pinned &&
+                    (victim == NULL || blk -> stamp < victim -> stamp)) {
+                        victim = blk;
+                }
+        }
+        assert(victim != NULL);
+
+        if (victim -> dirty) {
+                block_pack(array2b, victim);
+        }
+        cache_remove(array2b, victim);
+        UArray_free(&victim -> elems);
+}
+
+/**********cache_remove********
+ * Drops a resident block from the cache list (its cells are kept)
+ ************************/
+static void cache_remove(T array2b, Block blk)
+{
+        for (int i = 0; i < array2b -> resident; i++) {
+                if (array2b -> cache[i] == blk) {
+                        array2b -> cache[i] =
+                                array2b -> cache[--(array2b -> resident)];
+                        return;
+                }
+        }
+        assert(0);
+}
@@ -0,0 +1,173 @@
+/**************************************************************
+ *                     uarray2b.h
+ *
+ *     interface of the blocked array: the course interface plus the
+ *     compressed storage mode and whole-array transformations
+ *
+ **************************************************************/
+#ifndef UARRAY2B_INCLUDED
+#define UARRAY2B_INCLUDED
+
+#include <stddef.h>
+
+#define T UArray2b_T
+typedef struct T *T;
+
+/* new blocked 2d array: blocksize = square root of # of cells in block.
+ * Blocks are allocated on first touch, so cells nobody touches cost
+ * nothing and read as zero. Block rows are padded, and blocks
+ * staggered, as the padding policy in force says (see padding.h).
+ */
+extern T    UArray2b_new (int width, int height, int size, int blocksize);
+
+/* new blocked 2d array of blk_width x blk_height blocks, e.g. 64x8 so a
+ * block row fills whole cache lines
+ */
+extern T    UArray2b_new_rect(int width, int height, int size, int blk_width,
+                              int blk_height);
+
+/* new blocked 2d array: blocksize as large as possible provided
+ * block occupies at most 64KB (if possible)
+ */
+extern T    UArray2b_new_64K_block(int width, int height, int size);
+
+/* new blocked 2d array whose blocks are kept packed (uniform marker,
+ * run-length or verbatim) and expanded on access into an LRU cache of
+ * at most cache_blocks blocks; cache_blocks <= 0 picks a default.
+ * Pointers from UArray2b_at stay valid only until the next access.
+ */
+extern T    UArray2b_new_compressed(int width, int height, int size,
+                                    int blocksize, int cache_blocks);
+
+/* allocates a run of blocks up front, from the thread that should
+ * first touch them; blocks are otherwise allocated on first touch
+ */
+extern void UArray2b_alloc_range(T array2b, int first, int last);
+
+extern void  UArray2b_free     (T *array2b);
+
+extern int   UArray2b_width    (T  array2b);
+extern int   UArray2b_height   (T  array2b);
+extern int   UArray2b_size     (T  array2b);
+extern int   UArray2b_blocksize(T  array2b);
+extern int   UArray2b_block_width (T array2b);
+extern int   UArray2b_block_height(T array2b);
+extern int   UArray2b_compressed(T array2b);
+extern int   UArray2b_nblocks  (T  array2b);
+
+/* return a pointer to the cell in the given column and row, for
+ * writing: the cell's block is allocated, unshared and, if compressed,
+ * marked to be packed again. Readers should use UArray2b_get.
+ * index out of range is a checked run-time error
+ */
+extern void *UArray2b_at(T array2b, int column, int row);
+
+/* like UArray2b_at, but for reading only: a cell of a block that was
+ * never touched is read from a shared zero cell, without allocating
+ */
+extern const void *UArray2b_get(T array2b, int column, int row);
+
+/* visits every cell in one block before moving to another block */
+extern void  UArray2b_map(T array2b,
+                          void apply(int col, int row, T array2b,
+                                     void *elem, void *cl),
+                          void *cl);
+
+/* visits blocks along a Hilbert curve over the grid of blocks; the
+ * cells of a block are visited in storage order, or with cells nonzero
+ * along a Hilbert curve of their own
+ */
+extern void  UArray2b_map_hilbert(T array2b, int cells,
+                                  void apply(int col, int row, T array2b,
+                                             void *elem, void *cl),
+                                  void *cl);
+
+/* like UArray2b_map, but skips blocks that were never touched */
+extern void  UArray2b_map_touched(T array2b,
+                                  void apply(int col, int row, T array2b,
+                                             void *elem, void *cl),
+                                  void *cl);
+
+/* visits blocks first to last - 1, numbered in UArray2b_map's order */
+extern void  UArray2b_map_range(T array2b, int first, int last,
+                                void apply(int col, int row, T array2b,
+                                           void *elem, void *cl),
+                                void *cl);
+
+/* like UArray2b_map_range, but for reading: untouched blocks are not
+ * allocated (their cells all read as one shared zero cell) and shared
+ * blocks are not copied; apply must not write through elem
+ */
+extern void  UArray2b_read_range(T array2b, int first, int last,
+                                 void apply(int col, int row, T array2b,
+                                            void *elem, void *cl),
+                                 void *cl);
+
+/* how UArray2b_map_scheduled orders blocks and looks ahead: while a
+ * block is visited, the block distance places later is prefetched one
+ * row per visited row, and ahead (if not NULL) is told of each such row
+ * so the caller can prefetch whatever it will write for it
+ */
+struct UArray2b_schedule {
+        int distance;           /* blocks to look ahead, 0 for none */
+        int serpentine;         /* reverse every other row of blocks */
+        void (*ahead)(int col, int row, int width, int height, void *cl);
+        void *cl;               /* passed to ahead */
+};
+
+/* visits every cell one block at a time, in the schedule's order */
+extern void  UArray2b_map_scheduled(T array2b,
+                                    const struct UArray2b_schedule *schedule,
+                                    void apply(int col, int row, T array2b,
+                                               void *elem, void *cl),
+                                    void *cl);
+
+/* hints that the cells of the rectangle will soon be read (or, if write
+ * is nonzero, written); does nothing for compressed arrays
+ */
+extern void  UArray2b_prefetch(T array2b, int col, int row, int width,
+                               int height, int write);
+
+/* calls place on the cells of every block, split into nparts runs of
+ * consecutive blocks the same way Parallel_run splits its items
+ */
+extern void  UArray2b_place(T array2b, int nparts,
+                            void place(void *mem, size_t bytes, int part,
+                                       void *cl),
+                            void *cl);
+
+/* calls place on the cells of every allocated block, with the part
+ * owner returns for the block's middle cell
+ */
+extern void  UArray2b_place_owned(T array2b,
+                                  int owner(int col, int row, void *cl),
+                                  void place(void *mem, size_t bytes,
+                                             int part, void *cl),
+                                  void *cl);
+
+/* copies *elem into every cell of the rectangle; on compressed arrays
+ * blocks the rectangle covers become uniform without being expanded
+ */
+extern void  UArray2b_fill(T array2b, int col, int row, int width,
+                           int height, const void *elem);
+
+/* returns a new array with the same cells; uncompressed arrays share
+ * their blocks copy-on-write, so a block is only copied once one of the
+ * arrays writes to it (through UArray2b_at or a map)
+ */
+extern T     UArray2b_copy(T array2b);
+
+/* returns a new array holding array2b rotated clockwise by angle
+ * (0, 90, 180 or 270), with its block shape turned too; uniform blocks
+ * are filled wholesale and, for angle 0, the result is a UArray2b_copy
+ */
+extern T     UArray2b_rotate(T array2b, int angle);
+
+/* bytes of element storage the array holds right now */
+extern size_t UArray2b_footprint(T array2b);
+
+/* nonzero if some block is still shared with a copy of the array */
+extern int    UArray2b_shared(T array2b);
+
+#undef T
+#endif